@@ -0,0 +1,133 @@
+// Compiles generated programs of increasing size and writes the throughput of each to a JSON file
+#include "process.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define RUNS 3
+
+typedef struct Benchmark {
+  const char* name;
+  const char* generator_arguments[8];
+} Benchmark;
+
+static const Benchmark benchmarks[] = {
+    { "small", { "--globals=16", "--functions=16", "--statements=32", NULL } },
+    { "medium", { "--globals=64", "--functions=64", "--statements=256", "--strings=256", NULL } },
+    { "large", { "--globals=256", "--functions=256", "--statements=512", "--strings=1024", "--arrays=16", NULL } },
+    { "deep", { "--functions=64", "--statements=256", "--depth=8", NULL } },
+};
+
+static long count_lines(const char* path) {
+  FILE* file = fopen(path, "r");
+  if (file == NULL) {
+    return 0;
+  }
+
+  long lines = 0;
+  int c;
+  while ((c = fgetc(file)) != EOF) {
+    lines += c == '\n';
+  }
+  fclose(file);
+  return lines;
+}
+
+// The compiler prints its report as a single line of JSON
+static void copy_report(const char* path, FILE* out) {
+  FILE* file = fopen(path, "r");
+  if (file == NULL) {
+    fprintf(out, "null");
+    return;
+  }
+
+  char line[4096];
+  if (fgets(line, sizeof(line), file) == NULL) {
+    strcpy(line, "null");
+  }
+  line[strcspn(line, "\n")] = '\0';
+  fprintf(out, "%s", line);
+  fclose(file);
+}
+
+int main(int argc, char** argv) {
+  if (argc != 5) {
+    fprintf(stderr, "usage: %s <compiler> <generator> <working directory> <output.json>\n", argv[0]);
+    return 1;
+  }
+  // The compiler runs inside the working directory, since it always writes to out.s
+  mkdir(argv[3], 0755);
+  char* compiler = realpath(argv[1], NULL);
+  char* generator = realpath(argv[2], NULL);
+  char* directory = realpath(argv[3], NULL);
+  if (compiler == NULL || generator == NULL || directory == NULL) {
+    fprintf(stderr, "error: could not find the compiler, the generator or the working directory\n");
+    return 1;
+  }
+
+  FILE* out = fopen(argv[4], "w");
+  if (out == NULL) {
+    fprintf(stderr, "error: could not open output file \"%s\"\n", argv[4]);
+    return 1;
+  }
+
+  fprintf(out, "{\"benchmarks\": [\n");
+  int count = sizeof(benchmarks) / sizeof(benchmarks[0]);
+  for (int i = 0; i < count; i++) {
+    const Benchmark* benchmark = &benchmarks[i];
+
+    char program[1024], report[1024], best_report[1024];
+    snprintf(program, sizeof(program), "%s/%s.lang", directory, benchmark->name);
+    snprintf(report, sizeof(report), "%s/%s.report", directory, benchmark->name);
+    snprintf(best_report, sizeof(best_report), "%s/%s.best.report", directory, benchmark->name);
+
+    char* generator_argv[10] = { generator };
+    for (int j = 0; benchmark->generator_arguments[j] != NULL; j++) {
+      generator_argv[j + 1] = (char*)benchmark->generator_arguments[j];
+    }
+    struct rusage usage;
+    if (run_process(generator_argv, NULL, program, NULL, &usage) != 0) {
+      fprintf(stderr, "error: could not generate \"%s\"\n", program);
+      return 1;
+    }
+    long lines = count_lines(program);
+
+    // Keep the fastest run, the others only add scheduling noise
+    double best = -1;
+    long peak_rss = 0;
+    char* compiler_argv[] = { compiler, "--time-report=json", program, NULL };
+    for (int run_index = 0; run_index < RUNS; run_index++) {
+      double start = now();
+      if (run_process(compiler_argv, directory, "/dev/null", report, &usage) != 0) {
+        fprintf(stderr, "error: compiler failed on \"%s\", see \"%s\"\n", program, report);
+        return 1;
+      }
+      double elapsed = now() - start;
+
+      if (best < 0 || elapsed < best) {
+        best = elapsed;
+        peak_rss = usage.ru_maxrss;
+        rename(report, best_report);
+      }
+    }
+
+    fprintf(
+        out, "  {\"name\": \"%s\", \"lines\": %ld, \"wall_ms\": %.3f, \"lines_per_second\": %.0f, ", benchmark->name,
+        lines, best * 1e3, lines / best
+    );
+    fprintf(out, "\"peak_rss_kib\": %ld, \"report\": ", peak_rss);
+    copy_report(best_report, out);
+    fprintf(out, "}%s\n", i == count - 1 ? "" : ",");
+
+    printf(
+        "%-8s %8ld lines %10.3f ms %12.0f lines/s %8ld KiB\n", benchmark->name, lines, best * 1e3, lines / best,
+        peak_rss
+    );
+  }
+  fprintf(out, "]}\n");
+  fclose(out);
+
+  return 0;
+}
\ No newline at end of file
@@ -0,0 +1,241 @@
+// Deterministic generator of valid .lang programs, used to measure how the compiler scales
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct Options {
+  int globals;
+  int functions;
+  int statements; // Per function
+  int depth;      // Of expressions and nested statements
+  int arrays;
+  int array_size;
+  int strings;
+  uint64_t seed;
+} Options;
+
+static uint64_t state;
+
+// xorshift64*, so that the same seed gives the same program everywhere
+static uint32_t next_random() {
+  state ^= state >> 12;
+  state ^= state << 25;
+  state ^= state >> 27;
+  return (state * 2685821657736338717ull) >> 32;
+}
+
+static int random_below(int n) { return n <= 0 ? 0 : next_random() % n; }
+
+static Options options;
+static int strings_left;
+
+static void indent(FILE* out, int level) { fprintf(out, "%*s", level * 2, ""); }
+
+// Parameters are emitted as globals, so each function gets its own names for them
+static void write_expression(FILE* out, int function, int depth) {
+  if (depth <= 0 || random_below(4) == 0) {
+    switch (random_below(4)) {
+    case 0:
+      fprintf(out, "%d", random_below(100));
+      break;
+    case 1:
+      fprintf(out, "g%d", random_below(options.globals));
+      break;
+    case 2:
+      fprintf(out, "f%d_p%d", function, random_below(2));
+      break;
+    default:
+      if (options.arrays > 0) {
+        fprintf(out, "a%d[%d]", random_below(options.arrays), random_below(options.array_size));
+      } else {
+        fprintf(out, "f%d_p%d", function, random_below(2));
+      }
+    }
+    return;
+  }
+
+  // Only call functions defined before this one, so the call graph has no cycles
+  if (function > 0 && random_below(8) == 0) {
+    fprintf(out, "f%d(", random_below(function));
+    write_expression(out, function, depth - 1);
+    fprintf(out, ", ");
+    write_expression(out, function, depth - 1);
+    fprintf(out, ")");
+    return;
+  }
+
+  static const char* operators[] = { "+", "-", "*" };
+  fprintf(out, "(");
+  write_expression(out, function, depth - 1);
+  fprintf(out, " %s ", operators[random_below(3)]);
+  write_expression(out, function, depth - 1);
+  fprintf(out, ")");
+}
+
+static void write_condition(FILE* out, int function) {
+  static const char* comparisons[] = { "<", ">", "<=", ">=", "==", "!=" };
+  write_expression(out, function, options.depth / 2);
+  fprintf(out, " %s ", comparisons[random_below(6)]);
+  write_expression(out, function, options.depth / 2);
+}
+
+static int write_block(FILE* out, int function, int level, int budget);
+
+// Returns how many statements were written, nested ones included
+static int write_statement(FILE* out, int function, int level, int budget) {
+  int kind = random_below(level > options.depth ? 3 : 6);
+
+  if (kind == 2 && strings_left > 0) {
+    indent(out, level);
+    fprintf(out, "print \"string %d\\n\";\n", options.strings - strings_left);
+    strings_left--;
+    return 1;
+  }
+
+  if (kind < 3 || budget < 3) {
+    indent(out, level);
+    if (kind == 1 && options.arrays > 0) {
+      fprintf(out, "a%d[%d] = ", random_below(options.arrays), random_below(options.array_size));
+    } else {
+      fprintf(out, "g%d = ", random_below(options.globals));
+    }
+    write_expression(out, function, options.depth);
+    fprintf(out, ";\n");
+    return 1;
+  }
+
+  int inner_budget = 1 + random_below(budget / 2);
+  if (kind == 5) {
+    // Every function and nesting level has its own counter, so generated programs also terminate when run
+    indent(out, level);
+    fprintf(out, "f%d_l%d = 0;\n", function, level);
+    indent(out, level);
+    fprintf(out, "while (f%d_l%d < %d) {\n", function, level, 1 + random_below(10));
+    int written = write_block(out, function, level + 1, inner_budget);
+    indent(out, level + 1);
+    fprintf(out, "f%d_l%d = f%d_l%d + 1;\n", function, level, function, level);
+    indent(out, level);
+    fprintf(out, "}\n");
+    return written + 3;
+  }
+
+  indent(out, level);
+  fprintf(out, "if (");
+  write_condition(out, function);
+  fprintf(out, ") {\n");
+  int written = write_block(out, function, level + 1, inner_budget);
+  indent(out, level);
+  fprintf(out, "} else {\n");
+  written += write_block(out, function, level + 1, inner_budget);
+  indent(out, level);
+  fprintf(out, "}\n");
+  return written + 1;
+}
+
+static int write_block(FILE* out, int function, int level, int budget) {
+  int written = 0;
+  while (written < budget) {
+    written += write_statement(out, function, level, budget - written);
+  }
+  return written;
+}
+
+static void write_program(FILE* out) {
+  for (int i = 0; i < options.globals; i++) {
+    fprintf(out, "int g%d = %d;\n", i, random_below(100));
+  }
+  for (int i = 0; i < options.arrays; i++) {
+    fprintf(out, "int a%d[%d];\n", i, options.array_size);
+  }
+  for (int i = 0; i < options.functions; i++) {
+    for (int level = 1; level <= options.depth; level++) {
+      fprintf(out, "int f%d_l%d = 0;\n", i, level);
+    }
+  }
+  fprintf(out, "\n");
+
+  fprintf(out, "int main();\n");
+  for (int i = 0; i < options.functions; i++) {
+    fprintf(out, "int f%d(int f%d_p0, int f%d_p1);\n", i, i, i);
+  }
+  fprintf(out, "\n");
+
+  strings_left = options.strings;
+  for (int i = 0; i < options.functions; i++) {
+    fprintf(out, "code f%d {\n", i);
+    write_block(out, i, 1, options.statements);
+    indent(out, 1);
+    fprintf(out, "return ");
+    write_expression(out, i, options.depth);
+    fprintf(out, ";\n}\n\n");
+  }
+
+  fprintf(out, "code main {\n");
+  while (strings_left > 0) {
+    fprintf(out, "  print \"string %d\\n\";\n", options.strings - strings_left);
+    strings_left--;
+  }
+  for (int i = 0; i < options.functions; i++) {
+    fprintf(out, "  g0 = f%d(g0, %d);\n", i, i);
+  }
+  fprintf(out, "  return 0;\n}\n");
+}
+
+static int parse_option(const char* argument, const char* name, int* value) {
+  size_t length = strlen(name);
+  if (strncmp(argument, name, length) != 0 || argument[length] != '=') {
+    return 0;
+  }
+
+  *value = atoi(argument + length + 1);
+  return 1;
+}
+
+int main(int argc, char** argv) {
+  options = (Options) {
+      .globals = 16,
+      .functions = 16,
+      .statements = 32,
+      .depth = 4,
+      .arrays = 4,
+      .array_size = 16,
+      .strings = 16,
+      .seed = 1,
+  };
+
+  for (int i = 1; i < argc; i++) {
+    int seed;
+    if (parse_option(argv[i], "--globals", &options.globals) ||
+        parse_option(argv[i], "--functions", &options.functions) ||
+        parse_option(argv[i], "--statements", &options.statements) ||
+        parse_option(argv[i], "--depth", &options.depth) || parse_option(argv[i], "--arrays", &options.arrays) ||
+        parse_option(argv[i], "--array-size", &options.array_size) ||
+        parse_option(argv[i], "--strings", &options.strings)) {
+      continue;
+    }
+    if (parse_option(argv[i], "--seed", &seed)) {
+      options.seed = seed;
+      continue;
+    }
+
+    fprintf(
+        stderr,
+        "usage: %s [--globals=N] [--functions=N] [--statements=N] [--depth=N] [--arrays=N] [--array-size=N] "
+        "[--strings=N] [--seed=N]\n",
+        argv[0]
+    );
+    return 1;
+  }
+
+  if (options.globals < 1 || options.array_size < 1) {
+    fprintf(stderr, "error: need at least one global and arrays of at least one element\n");
+    return 1;
+  }
+
+  // xorshift gets stuck on zero
+  state = options.seed * 0x9E3779B97F4A7C15ull + 1;
+  write_program(stdout);
+
+  return 0;
+}
\ No newline at end of file
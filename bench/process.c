@@ -0,0 +1,42 @@
+#include "process.h"
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+int run_process(
+    char** argv, const char* directory, const char* stdout_path, const char* stderr_path, struct rusage* usage
+) {
+  pid_t pid = fork();
+  if (pid < 0) {
+    return -1;
+  }
+
+  if (pid == 0) {
+    if (directory != NULL && chdir(directory) != 0) {
+      _exit(127);
+    }
+    if (stdout_path != NULL) {
+      dup2(open(stdout_path, O_WRONLY | O_CREAT | O_TRUNC, 0644), STDOUT_FILENO);
+    }
+    if (stderr_path != NULL) {
+      dup2(open(stderr_path, O_WRONLY | O_CREAT | O_TRUNC, 0644), STDERR_FILENO);
+    }
+    execvp(argv[0], argv);
+    _exit(127);
+  }
+
+  int status;
+  wait4(pid, &status, 0, usage);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) == 127) {
+    return -1;
+  }
+  return WEXITSTATUS(status);
+}
+
+double now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec / 1e9;
+}
\ No newline at end of file
@@ -0,0 +1,15 @@
+#ifndef PROCESS_H
+#define PROCESS_H
+
+#include <sys/resource.h>
+
+// Runs `argv` (looked up in PATH) inside `directory` with the given standard streams (NULL to inherit). Returns the
+// exit status, or -1 when the process could not run or was killed
+int run_process(
+    char** argv, const char* directory, const char* stdout_path, const char* stderr_path, struct rusage* usage
+);
+
+// Monotonic time in seconds
+double now();
+
+#endif
\ No newline at end of file
@@ -0,0 +1,181 @@
+// Compiles, links and runs one benchmark kernel, checks its output and records how long it took to run
+#include "process.h"
+
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define RUNS 5
+
+// Kernels start with a "// expect: <text>" line, their output must end with that line
+static int read_expectation(const char* path, char* expected, size_t size) {
+  FILE* file = fopen(path, "r");
+  if (file == NULL) {
+    return 0;
+  }
+
+  char line[512];
+  int found = fgets(line, sizeof(line), file) != NULL && strncmp(line, "// expect: ", 11) == 0;
+  fclose(file);
+  if (found) {
+    line[strcspn(line, "\n")] = '\0';
+    snprintf(expected, size, "%s", line + 11);
+  }
+  return found;
+}
+
+static int last_line_matches(const char* path, const char* expected, long* bytes) {
+  FILE* file = fopen(path, "r");
+  if (file == NULL) {
+    return 0;
+  }
+
+  char line[512] = "", last[512] = "";
+  while (fgets(line, sizeof(line), file) != NULL) {
+    if (strcmp(line, "\n") != 0) {
+      strcpy(last, line);
+    }
+  }
+  *bytes = ftell(file);
+  fclose(file);
+
+  last[strcspn(last, "\n")] = '\0';
+  return strcmp(last, expected) == 0;
+}
+
+// perf is optional, -1 when it is not installed or not allowed to count
+static long count_instructions(char* executable, const char* directory) {
+  char* perf_argv[] = { "perf", "stat", "-x,", "-e", "instructions:u", "-o", "perf.csv", "--", executable, NULL };
+  struct rusage usage;
+  if (run_process(perf_argv, directory, "/dev/null", "/dev/null", &usage) != 0) {
+    return -1;
+  }
+
+  char path[2048];
+  snprintf(path, sizeof(path), "%s/perf.csv", directory);
+  FILE* file = fopen(path, "r");
+  if (file == NULL) {
+    return -1;
+  }
+
+  long instructions = -1;
+  char line[512];
+  while (fgets(line, sizeof(line), file) != NULL) {
+    if (strstr(line, "instructions") != NULL) {
+      instructions = strtol(line, NULL, 10);
+    }
+  }
+  fclose(file);
+  return instructions > 0 ? instructions : -1;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 5) {
+    fprintf(
+        stderr, "usage: %s <compiler> <c compiler> <kernel.lang> <working directory> [compiler options...]\n", argv[0]
+    );
+    return 1;
+  }
+  char* compiler = realpath(argv[1], NULL);
+  char* kernel = realpath(argv[3], NULL);
+  if (compiler == NULL || kernel == NULL) {
+    fprintf(stderr, "error: could not find the compiler or the kernel\n");
+    return 1;
+  }
+
+  char expected[512];
+  if (!read_expectation(kernel, expected, sizeof(expected))) {
+    fprintf(stderr, "error: \"%s\" does not start with an expect line\n", kernel);
+    return 1;
+  }
+
+  // Every kernel gets a directory of its own, since the compiler always writes to out.s
+  // Options become part of the name, so the same kernel can be measured at each optimization level
+  char name[256];
+  snprintf(name, sizeof(name), "%s", basename(argv[3]));
+  name[strcspn(name, ".")] = '\0';
+  for (int i = 5; i < argc; i++) {
+    strncat(name, argv[i], sizeof(name) - strlen(name) - 1);
+  }
+  mkdir(argv[4], 0755);
+  char* results_directory = realpath(argv[4], NULL);
+  if (results_directory == NULL) {
+    fprintf(stderr, "error: could not create the working directory \"%s\"\n", argv[4]);
+    return 1;
+  }
+  char directory[1024];
+  snprintf(directory, sizeof(directory), "%s/%s", results_directory, name);
+  mkdir(directory, 0755);
+
+  struct rusage usage;
+  char* compiler_argv[argc];
+  compiler_argv[0] = compiler;
+  for (int i = 5; i < argc; i++) {
+    compiler_argv[i - 4] = argv[i];
+  }
+  compiler_argv[argc - 4] = kernel;
+  compiler_argv[argc - 3] = NULL;
+  if (run_process(compiler_argv, directory, NULL, NULL, &usage) != 0) {
+    fprintf(stderr, "error: could not compile \"%s\"\n", kernel);
+    return 1;
+  }
+  char* link_argv[] = { argv[2], "-no-pie", "out.s", "-o", name, NULL };
+  if (run_process(link_argv, directory, NULL, NULL, &usage) != 0) {
+    fprintf(stderr, "error: could not assemble and link \"%s/out.s\"\n", directory);
+    return 1;
+  }
+
+  char executable[2048], output[2048];
+  snprintf(executable, sizeof(executable), "%s/%s", directory, name);
+  snprintf(output, sizeof(output), "%s/output.txt", directory);
+
+  // Keep the fastest run, the others only add scheduling noise
+  double best = -1;
+  long peak_rss = 0;
+  long bytes = 0;
+  char* kernel_argv[] = { executable, NULL };
+  for (int run = 0; run < RUNS; run++) {
+    double start = now();
+    int status = run_process(kernel_argv, directory, output, NULL, &usage);
+    double elapsed = now() - start;
+
+    if (status != 0 || !last_line_matches(output, expected, &bytes)) {
+      fprintf(stderr, "error: \"%s\" exited with %d, expected its output to end with \"%s\"\n", name, status, expected);
+      return 1;
+    }
+
+    if (best < 0 || elapsed < best) {
+      best = elapsed;
+      peak_rss = usage.ru_maxrss;
+    }
+  }
+  long instructions = count_instructions(executable, directory);
+
+  char results[2048];
+  snprintf(results, sizeof(results), "%s/%s.json", results_directory, name);
+  FILE* out = fopen(results, "w");
+  if (out == NULL) {
+    fprintf(stderr, "error: could not open output file \"%s\"\n", results);
+    return 1;
+  }
+  fprintf(
+      out, "{\"name\": \"%s\", \"wall_ms\": %.3f, \"peak_rss_kib\": %ld, \"output_bytes\": %ld, ", name, best * 1e3,
+      peak_rss, bytes
+  );
+  if (instructions < 0) {
+    fprintf(out, "\"instructions\": null}\n");
+  } else {
+    fprintf(out, "\"instructions\": %ld}\n", instructions);
+  }
+  fclose(out);
+
+  printf("%s: %.3f ms, %ld KiB", name, best * 1e3, peak_rss);
+  if (instructions >= 0) {
+    printf(", %ld instructions", instructions);
+  }
+  printf("\n");
+
+  return 0;
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#include "arena.h"
+
+#include <stdalign.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHUNK_SIZE (64 * 1024)
+#define ALIGNMENT  alignof(max_align_t)
+
+static size_t align(size_t size) { return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1); }
+
+static char* chunk_data(ArenaChunk* chunk) { return (char*)chunk + align(sizeof(ArenaChunk)); }
+
+void* arena_alloc(Arena* arena, size_t size) {
+  size = align(size);
+
+  ArenaChunk* chunk = arena->chunks;
+  if (chunk == NULL || chunk->used + size > chunk->size) {
+    size_t chunk_size = size > CHUNK_SIZE ? size : CHUNK_SIZE;
+    chunk = malloc(align(sizeof(ArenaChunk)) + chunk_size);
+    chunk->size = chunk_size;
+    chunk->used = 0;
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+    arena->reserved += chunk_size;
+  }
+
+  void* pointer = chunk_data(chunk) + chunk->used;
+  chunk->used += size;
+  arena->allocated += size;
+  arena->last_allocation = pointer;
+  return pointer;
+}
+
+void* arena_realloc(Arena* arena, void* pointer, size_t old_size, size_t new_size) {
+  if (pointer == NULL) {
+    return arena_alloc(arena, new_size);
+  }
+
+  ArenaChunk* chunk = arena->chunks;
+  if (pointer == arena->last_allocation) {
+    size_t start = (char*)pointer - chunk_data(chunk);
+    if (start + align(new_size) <= chunk->size) {
+      arena->allocated += align(new_size) - (chunk->used - start);
+      chunk->used = start + align(new_size);
+      return pointer;
+    }
+  }
+
+  void* moved = arena_alloc(arena, new_size);
+  memcpy(moved, pointer, old_size < new_size ? old_size : new_size);
+  return moved;
+}
+
+char* arena_strdup(Arena* arena, const char* string) {
+  size_t size = strlen(string) + 1;
+  char* copy = arena_alloc(arena, size);
+  memcpy(copy, string, size);
+  return copy;
+}
+
+void arena_free(Arena* arena) {
+  ArenaChunk* chunk = arena->chunks;
+  while (chunk != NULL) {
+    ArenaChunk* next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+
+  arena->chunks = NULL;
+  arena->last_allocation = NULL;
+  arena->allocated = 0;
+  arena->reserved = 0;
+}
+
+void print_arena_stats(FILE* out, Arena* arena) {
+  fprintf(out, "%-20s %12zu bytes allocated %12zu bytes reserved\n", arena->name, arena->allocated, arena->reserved);
+}
\ No newline at end of file
@@ -0,0 +1,30 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+typedef struct ArenaChunk {
+  struct ArenaChunk* next;
+  size_t size;
+  size_t used;
+} ArenaChunk;
+
+// Region allocator: objects are never freed one by one, the whole arena is released at once
+typedef struct Arena {
+  const char* name;
+  ArenaChunk* chunks; // Newest first, allocations come from the head
+  void* last_allocation;
+  size_t allocated; // Bytes handed out
+  size_t reserved;  // Bytes requested from the system
+} Arena;
+
+void* arena_alloc(Arena* arena, size_t size);
+// Grows in place when `pointer` is the latest allocation, copies otherwise
+void* arena_realloc(Arena* arena, void* pointer, size_t old_size, size_t new_size);
+char* arena_strdup(Arena* arena, const char* string);
+void arena_free(Arena* arena);
+
+void print_arena_stats(FILE* out, Arena* arena);
+
+#endif
\ No newline at end of file
@@ -1,26 +1,50 @@
 #include "asm.h"
 
 #include "intermediary-code.h"
+#include "optimizations.h"
+#include "register-allocation.h"
 
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
-#define space()      fprintf(out, " ")
-#define tabs(n)      fprintf(out, "%*s", (n)*TAB_SIZE, "")
-#define character(c) fprintf(out, "%c", c)
-#define string(s)    fprintf(out, "%s", s)
-#define integer(i)   fprintf(out, "%d", i)
-#define floating(f)  fprintf(out, "%g", f);
+#define space()      output_char(out, ' ')
+#define character(c) output_char(out, c)
+#define string(s)    output_string(out, s)
+#define integer(i)   output_int(out, i)
 
-static void print_literal(Literal literal, FILE* out) {
+#define ELEMENT_SIZE          4 // Every type is emitted as .int or .float
+#define INITIALIZERS_PER_LINE 16
+
+// Local labels, no identifier of the language can start with a dot
+#define BOUNDS_ERROR    ".Lbounds_error"
+#define BOUNDS_MESSAGE  ".Lbounds_message"
+#define FLOAT_CONSTANTS ".Lfloat_" // Followed by the index in the pool
+
+static void print_literal(Literal literal, Output* out) {
   match(literal) {
-    of(IntLiteral, i) fprintf(out, "%d", *i);
-    of(FloatLiteral, f) fprintf(out, "%g", *f);
-    of(CharLiteral, c) fprintf(out, "'%c'", *c);
-    of(StringLiteral, s) fprintf(out, "\"%s\"", *s);
+    of(IntLiteral, i) integer(*i);
+    of(FloatLiteral, f) {
+      // Enough digits to assemble to the same float, %g stops at 6
+      char digits[32];
+      snprintf(digits, sizeof(digits), "%.9g", *f);
+      string(digits);
+    }
+    of(CharLiteral, c) {
+      character('\'');
+      character(*c);
+      character('\'');
+    }
+    of(StringLiteral, s) {
+      character('"');
+      string(*s);
+      character('"');
+    }
   }
 }
 
-static void print_type(Type type, FILE* out) {
+static void print_type(Type type, Output* out) {
   match(type) {
     of(IntegerType) string(".int");
     of(FloatType) string(".float");
@@ -28,11 +52,11 @@ static void print_type(Type type, FILE* out) {
   }
 }
 
-void write_declarations(DeclarationList* declarations, FILE* out) {
+void write_declarations(DeclarationList* declarations, Output* out) {
   while (declarations != NULL) {
     match(declarations->declaration) {
       of(VariableDeclaration, type, identifier, value) {
-        string(*identifier);
+        string(string_of(*identifier));
         string(": ");
         print_type(*type, out);
         space();
@@ -40,275 +64,1111 @@ void write_declarations(DeclarationList* declarations, FILE* out) {
         string("\n");
       }
       of(ArrayDeclaration, type, identifier, size, initialization) {
-        string("_");
-        string(*identifier);
-        string(": ");
-
-        int i = 0;
-        ArrayInitialization* list = *initialization;
-        while (i < *size || list != NULL) {
-          print_type(*type, out);
-          space();
+        // Without initializers they go to .bss instead, see write_zeroed_arrays
+        if (*initialization != NULL) {
+          string("_");
+          string(string_of(*identifier));
+          string(":");
 
-          if (list != NULL) {
+          // Initializers are packed a few per line, and whatever they leave out is zeroed in one go
+          int i = 0;
+          for (ArrayInitialization* list = *initialization; list != NULL; list = list->next, i++) {
+            if (i % INITIALIZERS_PER_LINE == 0) {
+              string(i == 0 ? " " : "\n  ");
+              print_type(*type, out);
+              space();
+            } else {
+              string(", ");
+            }
             print_literal(list->value, out);
-            list = list->next;
-          } else {
-            integer(0);
           }
-          i++;
           string("\n");
+          if (i < *size) {
+            string("  .zero ");
+            integer((*size - i) * ELEMENT_SIZE);
+            string("\n");
+          }
         }
       }
-      of(FunctionDeclaration, _, _, parameters) {
-        ParametersDeclaration* paramsList = *parameters;
-        while (paramsList != NULL) {
-          string(paramsList->name);
-          string(": ");
-          print_type(paramsList->type, out);
-          string(" 0\n");
+      of(FunctionDeclaration, _, _, _) { } // Parameters live in registers or in the frame of each call
+    }
 
-          paramsList = paramsList->next;
+    declarations = declarations->next;
+  }
+}
+
+// Arrays without initializers take no space in the executable, and a single line of assembly however large they are
+void write_zeroed_arrays(DeclarationList* declarations, Output* out) {
+  for (; declarations != NULL; declarations = declarations->next) {
+    match(declarations->declaration) {
+      of(ArrayDeclaration, _, identifier, size, initialization) {
+        if (*initialization == NULL) {
+          string("_");
+          string(string_of(*identifier));
+          string(": .zero ");
+          integer(*size * ELEMENT_SIZE);
+          string("\n");
         }
       }
+      otherwise { }
     }
+  }
+}
 
-    declarations = declarations->next;
+typedef struct StringConstant {
+  StringDeclarationList* declaration;
+  size_t length;
+  int host; // Index of the constant whose tail this one is, itself when it's emitted on its own
+} StringConstant;
+
+// Backwards comparison, so a string ends up right before the ones it is a suffix of
+static int by_reversed_text(const void* a, const void* b) {
+  const StringConstant* left = a;
+  const StringConstant* right = b;
+  size_t i = left->length;
+  size_t j = right->length;
+  while (i > 0 && j > 0) {
+    unsigned char l = left->declaration->value[--i];
+    unsigned char r = right->declaration->value[--j];
+    if (l != r) {
+      return l - r;
+    }
+  }
+  return (i > 0) - (j > 0);
+}
+
+// Whether `tail` can point into the end of `host`. Escape sequences only take up one byte once assembled, so offsets
+// are only known when the part skipped over has none
+static int shares_tail(StringConstant* tail, StringConstant* host) {
+  if (tail->length > host->length) {
+    return 0;
+  }
+  size_t offset = host->length - tail->length;
+  return strcmp(host->declaration->value + offset, tail->declaration->value) == 0 &&
+         memchr(host->declaration->value, '\\', offset) == NULL;
+}
+
+// Constants that are the tail of a longer one are just a label into it. The section is mergeable, so the linker can
+// still fold identical strings from other objects. Constants the optimizer left without uses are skipped
+void write_string_literals(Output* out, int* use_count) {
+  int count = 0;
+  for (StringDeclarationList* list = string_constants; list != NULL; list = list->next) {
+    count++;
+  }
+
+  StringConstant* constants = arena_alloc(&asm_arena, count * sizeof(StringConstant));
+  count = 0;
+  for (StringDeclarationList* list = string_constants; list != NULL; list = list->next) {
+    if (use_count[list->identifier] > 0) {
+      constants[count++] = (StringConstant) { .declaration = list, .length = strlen(list->value) };
+    }
+  }
+  qsort(constants, count, sizeof(StringConstant), by_reversed_text);
+
+  for (int c = count - 1; c >= 0; c--) {
+    int next_host = c + 1 < count ? constants[c + 1].host : -1;
+    constants[c].host = next_host != -1 && shares_tail(&constants[c], &constants[next_host]) ? next_host : c;
+  }
+
+  for (int c = 0; c < count; c++) {
+    StringConstant* constant = &constants[c];
+    string(string_of(constant->declaration->identifier));
+    if (constant->host == c) {
+      string(": .asciz \"");
+      string(constant->declaration->value);
+      string("\"\n");
+    } else {
+      string(" = ");
+      string(string_of(constants[constant->host].declaration->identifier));
+      string(" + ");
+      integer(constants[constant->host].length - constant->length);
+      string("\n");
+    }
+  }
+}
+
+Arena asm_arena = { .name = "assembly" };
+
+typedef struct AsmInstruction {
+  Label label;             // Label placed right before this instruction, or NO_STRING
+  const char* mnemonic;    // NULL for lines that only hold a label (or nothing at all)
+  const char* operands[2]; // NULL when unused
+  const char* comment;
+} AsmInstruction;
+
+// In-memory listing of the text section, so we can optimize it before writing anything out
+struct AsmCode {
+  AsmInstruction* instructions;
+  int size;
+  int capacity;
+  Label pending_label;
+
+  RegisterAllocation* allocation;
+  int* use_count;              // Indexed by StringId
+  Frame* frame;                // Of the function being lowered
+  const char** slot_operands;  // Formatted once per slot of `frame`, NULL until first needed
+  int checks_bounds;           // Whether anything jumps to BOUNDS_ERROR
+
+  // Bit patterns of the float literals, emitted once each in .rodata
+  uint32_t* float_constants;
+  int float_count;
+  int float_capacity;
+
+  // Sources of the ICArgument instructions seen since the last call
+  Storage* arguments;
+  int argument_count;
+  int argument_capacity;
+};
+
+static void append_instruction(AsmCode* code, AsmInstruction instruction) {
+  if (code->size == code->capacity) {
+    int capacity = code->capacity == 0 ? 1024 : code->capacity * 2;
+    code->instructions = arena_realloc(
+        &asm_arena, code->instructions, code->capacity * sizeof(AsmInstruction), capacity * sizeof(AsmInstruction)
+    );
+    code->capacity = capacity;
+  }
+
+  instruction.label = code->pending_label;
+  code->pending_label = NO_STRING;
+  code->instructions[code->size++] = instruction;
+}
+
+static void emit_comment(
+    AsmCode* code, const char* mnemonic, const char* first, const char* second, const char* comment
+) {
+  append_instruction(
+      code, (AsmInstruction) { .mnemonic = mnemonic, .operands = { first, second }, .comment = comment }
+  );
+}
+
+static void emit(AsmCode* code, const char* mnemonic, const char* first, const char* second) {
+  emit_comment(code, mnemonic, first, second, NULL);
+}
+
+static void emit_label(AsmCode* code, Label label) {
+  // Two labels in a row, give the first one a line of its own
+  if (code->pending_label != NO_STRING) {
+    append_instruction(code, (AsmInstruction) { .mnemonic = NULL });
+  }
+  code->pending_label = label;
+}
+
+static char* operand(const char* format, ...) {
+  char buffer[512];
+
+  va_list args;
+  va_start(args, format);
+  vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+
+  return arena_strdup(&asm_arena, buffer);
+}
+
+static int is_register(const char* operand) { return operand[0] == '%'; }
+
+static int is_float_register(const char* operand) { return strncmp(operand, "%xmm", 4) == 0; }
+
+// SSE has no immediates, float literals are loaded from a pool instead
+static const char* float_constant(AsmCode* code, float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+
+  int index = 0;
+  while (index < code->float_count && code->float_constants[index] != bits) {
+    index++;
+  }
+  if (index == code->float_count) {
+    if (code->float_count == code->float_capacity) {
+      int capacity = code->float_capacity == 0 ? 16 : code->float_capacity * 2;
+      code->float_constants = arena_realloc(
+          &asm_arena, code->float_constants, code->float_capacity * sizeof(uint32_t), capacity * sizeof(uint32_t)
+      );
+      code->float_capacity = capacity;
+    }
+    code->float_constants[code->float_count++] = bits;
+  }
+  return operand(FLOAT_CONSTANTS "%d(%%rip)", index);
+}
+
+// Register, frame slot, global or pool entry holding `storage`
+static const char* location(AsmCode* code, Storage storage) {
+  float value;
+  if (float_literal_value(storage, &value)) {
+    return float_constant(code, value);
+  }
+
+  const char* name = register_of(code->allocation, storage);
+  if (name != NULL) {
+    return name;
+  }
+
+  int slot = slot_of(code->allocation, storage);
+  if (slot == -1) {
+    return string_of(storage);
   }
+  if (code->slot_operands[slot] != NULL) {
+    return code->slot_operands[slot];
+  }
+  // Slots go right below the saved registers, or in the red zone when there's no frame pointer
+  if (code->frame->has_frame_pointer) {
+    code->slot_operands[slot] =
+        operand("-%d(%%rbp)", 8 * __builtin_popcount(code->frame->saved_registers) + 4 * (slot + 1));
+  } else {
+    code->slot_operands[slot] = operand("-%d(%%rsp)", 4 * (slot + 1));
+  }
+  return code->slot_operands[slot];
+}
+
+static int is_mov(AsmInstruction* instruction) {
+  return instruction->mnemonic != NULL && strcmp(instruction->mnemonic, "mov") == 0;
 }
 
-// HACK: Huuuge hack to declare string literals
-extern StringDeclarationList* string_constants;
 
-void write_string_literals(FILE* out) {
-  StringDeclarationList* list = string_constants;
-  while (list != NULL) {
-    fprintf(out, "%s: .asciz \"%s\"\n", list->identifier, list->value);
+int movs_elided = 0;
+
+// Peephole optimization over a sliding window of two instructions. A labeled instruction may be a jump target, so
+// nothing is ever combined across it
+static void peephole(AsmCode* code) {
+  int kept = 0;
+
+  for (int i = 0; i < code->size; i++) {
+    AsmInstruction current = code->instructions[i];
+    AsmInstruction* previous = kept > 0 ? &code->instructions[kept - 1] : NULL;
+
+    if (is_mov(&current)) {
+      const char* src = current.operands[0];
+      const char* dst = current.operands[1];
+
+      // mov a, a
+      if (strcmp(src, dst) == 0) {
+        movs_elided++;
+        if (current.label != NO_STRING) {
+          code->instructions[kept++] = (AsmInstruction) { .label = current.label, .mnemonic = NULL };
+        }
+        continue;
+      }
+
+      if (current.label == NO_STRING && previous != NULL && is_mov(previous)) {
+        const char* previous_src = previous->operands[0];
+        const char* previous_dst = previous->operands[1];
+
+        // mov a, b; mov a, b
+        if (strcmp(previous_src, src) == 0 && strcmp(previous_dst, dst) == 0) {
+          movs_elided++;
+          continue;
+        }
+
+        // mov a, b; mov b, a
+        if (strcmp(previous_src, dst) == 0 && strcmp(previous_dst, src) == 0) {
+          movs_elided++;
+          continue;
+        }
+
+        // Load after store: mov a, slot; mov slot, c => mov a, slot; mov a, c
+        // Only when the result still has a register operand, x86 can't move from memory to memory
+        if (!is_register(previous_dst) && strcmp(previous_dst, src) == 0 &&
+            (is_register(previous_src) || is_register(dst))) {
+          if (strcmp(previous_src, dst) == 0) {
+            movs_elided++;
+            continue;
+          }
+          current.operands[0] = previous_src;
+        }
+      }
+    }
+
+    code->instructions[kept++] = current;
+  }
+
+  code->size = kept;
+}
+
+static void write_instructions(AsmCode* code, Output* out) {
+  for (int i = 0; i < code->size; i++) {
+    AsmInstruction* instruction = &code->instructions[i];
+
+    if (instruction->label != NO_STRING) {
+      string(string_of(instruction->label));
+      string(":");
+    }
+
+    if (instruction->mnemonic != NULL) {
+      if (instruction->label != NO_STRING) {
+        space();
+      }
+      string(instruction->mnemonic);
+      if (instruction->operands[0] != NULL) {
+        space();
+        string(instruction->operands[0]);
+      }
+      if (instruction->operands[1] != NULL) {
+        string(", ");
+        string(instruction->operands[1]);
+      }
+    }
+
+    if (instruction->comment != NULL) {
+      string(" # ");
+      string(instruction->comment);
+    }
 
-    list = list->next;
+    string("\n");
   }
 }
 
-int count_lines(FILE* out) {
-  int line_number = 0;
+// Signed condition code of a comparison operator, NULL for anything else
+static const char* condition_code(BinaryOperator operator, int negated) {
+  match(operator) {
+    of(LessThanOperator) return negated ? "ge" : "l";
+    of(GreaterThanOperator) return negated ? "le" : "g";
+    of(LessOrEqualOperator) return negated ? "g" : "le";
+    of(GreaterOrEqualOperator) return negated ? "l" : "ge";
+    of(EqualsOperator) return negated ? "ne" : "e";
+    of(DiffersOperator) return negated ? "e" : "ne";
+    otherwise return NULL;
+  }
+  return NULL;
+}
+
+// Compares `work` against `right`, leaving the boolean result in `work`
+static void write_comparison(AsmCode* out, BinaryOperator operator, const char* right, const char* work) {
+  emit(out, "cmp", right, work);
+  emit(out, "mov", "$0", "%eax");
+  emit(out, operand("set%s", condition_code(operator, 0)), "%al", NULL);
+  emit(out, "mov", "%eax", work);
+}
 
-  rewind(out);
+// Moves between XMM registers copy the whole register, so they don't wait on whatever was in it before
+static const char* move_mnemonic(const char* source, const char* destination) {
+  if (is_float_register(source) && is_float_register(destination)) {
+    return "movaps";
+  }
+  return is_float_register(source) || is_float_register(destination) ? "movss" : "mov";
+}
 
-  char ch = fgetc(out);
-  while (!feof(out)) {
-    if (ch == '\n') {
-      line_number++;
+// x86 can't move from memory to memory, those go through %r10d. A float's bits can travel that way too
+static void write_move(AsmCode* out, const char* source, const char* destination) {
+  if (is_float_register(source) || is_float_register(destination)) {
+    if (strcmp(source, destination) != 0) {
+      emit(out, move_mnemonic(source, destination), source, destination);
     }
-    ch = fgetc(out);
+  } else if (is_register(destination) || is_register(source)) {
+    emit(out, "mov", source, destination);
+  } else {
+    emit(out, "mov", source, "%r10d");
+    emit(out, "mov", "%r10d", destination);
   }
+}
 
-  return line_number;
+// Condition code after write_float_compare. Unordered results set ZF, PF and CF, so "above" and "above or equal" are
+// false for NaN like every C comparison but !=. Equality needs PF checked on top of it
+static const char* float_condition_code(BinaryOperator operator, int negated) {
+  match(operator) {
+    of(LessThanOperator) return negated ? "be" : "a";
+    of(GreaterThanOperator) return negated ? "be" : "a";
+    of(LessOrEqualOperator) return negated ? "b" : "ae";
+    of(GreaterOrEqualOperator) return negated ? "b" : "ae";
+    of(EqualsOperator) return negated ? "ne" : "e";
+    of(DiffersOperator) return negated ? "e" : "ne";
+    otherwise return NULL;
+  }
+  return NULL;
 }
 
-// Optimization to remember what value was inside each register and only load if necessary
-void write_mov(FILE* out, char* src, char* dst) {
-  // goto end; // Uncomment to turn off this optimization
+// ucomiss with the operands swapped for < and <=, so they become > and >=
+static void write_float_compare(AsmCode* out, BinaryOperator operator, Storage left, Storage right) {
+  int swapped = MATCHES(operator, LessThanOperator) || MATCHES(operator, LessOrEqualOperator);
+  const char* first = location(out, swapped ? right : left);
+  if (!is_float_register(first)) {
+    emit(out, "movss", first, "%xmm0");
+    first = "%xmm0";
+  }
+  emit(out, "ucomiss", location(out, swapped ? left : right), first);
+}
+
+static int is_float_operation(IC* instruction) {
+  match(*instruction) {
+    of(ICBinOp, _, _, left, right) return is_float(*left) || is_float(*right);
+    otherwise return 0;
+  }
+  return 0;
+}
 
-  static int last_instruction = -1;
-  int current_instruction = count_lines(out);
+// Float arithmetic in XMM registers, and comparisons of floats into an int
+static void write_float_operation(AsmCode* out, IC* instruction) {
+  match(*instruction) {
+    of(ICBinOp, operator, dst, left, right) {
+      const char* destination = location(out, *dst);
+      const char* mnemonic = NULL;
+      match(*operator) {
+        of(SumOperator) mnemonic = "addss";
+        of(SubtractionOperator) mnemonic = "subss";
+        of(MultiplicationOperator) mnemonic = "mulss";
+        of(DivisionOperator) mnemonic = "divss";
+        otherwise { }
+      }
+
+      if (mnemonic == NULL) {
+        write_float_compare(out, *operator, *left, *right);
+        emit(out, "mov", "$0", "%eax");
+        emit(out, operand("set%s", float_condition_code(*operator, 0)), "%al", NULL);
+        if (MATCHES(*operator, EqualsOperator) || MATCHES(*operator, DiffersOperator)) {
+          int equals = MATCHES(*operator, EqualsOperator);
+          emit(out, "mov", "$0", "%edx");
+          emit(out, equals ? "setnp" : "setp", "%dl", NULL);
+          emit(out, equals ? "and" : "or", "%edx", "%eax");
+        }
+        emit(out, "mov", "%eax", destination);
+        return;
+      }
 
-  static char* last_src = NULL;
-  static char* last_dst = NULL;
+      // Compute straight into the destination's register, unless that would overwrite `right` before reading it. Sums
+      // and products can read it first instead
+      Storage first = *left, second = *right;
+      int is_commutative = MATCHES(*operator, SumOperator) || MATCHES(*operator, MultiplicationOperator);
+      if (is_commutative && strcmp(location(out, second), destination) == 0) {
+        first = *right;
+        second = *left;
+      }
+      const char* source = location(out, second);
+      const char* work = is_float_register(destination) && strcmp(destination, source) != 0 ? destination : "%xmm0";
+      write_move(out, location(out, first), work);
+      emit(out, mnemonic, source, work);
+      write_move(out, work, destination);
+    }
+    otherwise { }
+  }
+}
 
-  // Assert we're the very next instruction
-  if (current_instruction - 1 != last_instruction) {
-    goto end;
+// 64 bit view of a register the instruction selection computes in, for addressing. NULL for anything else
+static const char* quadword_of(const char* name) {
+  for (int r = 0; r < REGISTER_COUNT; r++) {
+    if (strcmp(registers[r].name, name) == 0) {
+      return registers[r].quadword;
+    }
   }
+  return strcmp(name, "%r10d") == 0 ? "%r10" : NULL;
+}
 
-  // Assert there are available labels
-  if (last_src == NULL || last_dst == NULL) {
-    goto end;
+// `work *= value` with shifts and lea where they beat imul: powers of two, and 3, 5 or 9 times one
+static void write_multiplication_by(AsmCode* out, int value, const char* work) {
+  if (value == 0) {
+    emit(out, "mov", "$0", work);
+    return;
   }
 
-  // We're moving back and forth! No need to do it
-  if (strcmp(last_src, dst) == 0 && strcmp(last_dst, src) == 0) {
-    last_instruction = current_instruction;
-    last_src = src;
-    last_dst = dst;
+  unsigned magnitude = value < 0 ? 0u - (unsigned)value : (unsigned)value;
+  int shift = __builtin_ctz(magnitude);
+  unsigned odd = magnitude >> shift;
+  const char* quadword = quadword_of(work);
+  int uses_lea = value > 0 && (odd == 3 || odd == 5 || odd == 9) && quadword != NULL;
+  if (odd != 1 && !uses_lea) {
+    emit(out, "imul", operand("$%d", value), work);
     return;
   }
 
-end:
-  fprintf(out, "mov %s, %s\n", src, dst);
-  last_instruction = current_instruction;
-  last_src = src;
-  last_dst = dst;
+  if (uses_lea) {
+    emit(out, "lea", operand("(%s,%s,%u)", quadword, quadword, odd - 1), work);
+  }
+  if (shift > 0) {
+    emit(out, "shl", operand("$%d", shift), work);
+  }
+  if (value < 0) {
+    emit(out, "neg", work, NULL);
+  }
+}
+
+// Hacker's Delight, figure 10-1: n / divisor is the high half of n * multiplier shifted right by `shift`, plus one
+// when that is negative. Only for divisors whose magnitude isn't a power of two
+static void division_magic(int divisor, int* multiplier, int* shift) {
+  const unsigned two31 = 0x80000000u;
+  unsigned magnitude = divisor < 0 ? 0u - (unsigned)divisor : (unsigned)divisor;
+  unsigned t = two31 + ((unsigned)divisor >> 31);
+  unsigned limit = t - 1 - t % magnitude; // Absolute value of nc
+  unsigned q1 = two31 / limit, r1 = two31 - q1 * limit;
+  unsigned q2 = two31 / magnitude, r2 = two31 - q2 * magnitude;
+  unsigned delta;
+  int p = 31;
+  do {
+    p++;
+    q1 *= 2;
+    r1 *= 2;
+    if (r1 >= limit) {
+      q1++;
+      r1 -= limit;
+    }
+    q2 *= 2;
+    r2 *= 2;
+    if (r2 >= magnitude) {
+      q2++;
+      r2 -= magnitude;
+    }
+    delta = magnitude - r2;
+  } while (q1 < delta || (q1 == delta && r1 == 0));
+
+  *multiplier = (int)(divisor < 0 ? 0u - (q2 + 1) : q2 + 1);
+  *shift = p - 32;
+}
+
+// `work = dividend / value`, truncating toward zero like idiv does. Not for 0 and -1, which must still trap on
+// the same inputs idiv traps on
+static void write_division_by(AsmCode* out, const char* dividend, int value, const char* work) {
+  unsigned magnitude = value < 0 ? 0u - (unsigned)value : (unsigned)value;
+  if ((magnitude & (magnitude - 1)) == 0) {
+    // An arithmetic shift rounds down, negative dividends get 2^shift - 1 added first to round toward zero instead
+    int shift = __builtin_ctz(magnitude);
+    emit(out, "mov", dividend, work);
+    if (shift > 0) {
+      emit(out, "mov", work, "%eax");
+      if (shift > 1) {
+        emit(out, "sar", "$31", "%eax");
+      }
+      emit(out, "shr", operand("$%d", 32 - shift), "%eax");
+      emit(out, "add", "%eax", work);
+      emit(out, "sar", operand("$%d", shift), work);
+    }
+    if (value < 0) {
+      emit(out, "neg", work, NULL);
+    }
+    return;
+  }
+
+  int multiplier, shift;
+  division_magic(value, &multiplier, &shift);
+  emit(out, "mov", dividend, "%r11d");
+  emit(out, "mov", operand("$%d", multiplier), "%eax");
+  emit(out, "imul", "%r11d", NULL);
+  if (value > 0 && multiplier < 0) {
+    emit(out, "add", "%r11d", "%edx");
+  } else if (value < 0 && multiplier > 0) {
+    emit(out, "sub", "%r11d", "%edx");
+  }
+  if (shift > 0) {
+    emit(out, "sar", operand("$%d", shift), "%edx");
+  }
+  emit(out, "mov", "%edx", "%eax");
+  emit(out, "shr", "$31", "%eax");
+  emit(out, "add", "%eax", "%edx");
+  emit(out, "mov", "%edx", work);
+}
+
+// Memory operand of `array[index]`. Executables are linked without PIE, so the array's address fits in the
+// displacement and the index is scaled in the same operand. The index is sign extended into %r11 first
+static const char* array_element(AsmCode* out, Storage array, Storage index) {
+  int value;
+  if (literal_value(index, &value)) {
+    return operand("_%s+%d", string_of(array), value * ELEMENT_SIZE);
+  }
+  emit(out, "movslq", location(out, index), "%r11");
+  return operand("_%s(,%%r11,%d)", string_of(array), ELEMENT_SIZE);
+}
+
+// A comparison whose only use is the conditional jump right after it becomes a cmp and a jcc, without materializing
+// the boolean
+static int is_fused_comparison(IntermediaryCode* code, AsmCode* out, int i) {
+  if (i + 1 >= code->size || code->instructions[i + 1].label != NO_STRING) {
+    return 0;
+  }
+
+  IC* next = &code->instructions[i + 1].instruction;
+  match(code->instructions[i].instruction) {
+    of(ICBinOp, operator, dst, left, _) {
+      if (condition_code(*operator, 0) == NULL || !is_temporary(*dst) || out->use_count[*dst] != 1) {
+        return 0;
+      }
+      // Jumping when two floats are equal and ordered would take a second label
+      if (is_float(*left) && MATCHES(*operator, DiffersOperator)) {
+        return 0;
+      }
+      match(*next) {
+        of(ICJumpIfFalse, condition, _) return *condition == *dst;
+        otherwise return 0;
+      }
+    }
+    otherwise return 0;
+  }
+  return 0;
+}
+
+static void write_fused_comparison(AsmCode* out, IC* comparison, IC* jump) {
+  const char* target = NULL;
+  match(*jump) {
+    of(ICJumpIfFalse, _, label) target = string_of(*label);
+    otherwise { }
+  }
+
+  match(*comparison) {
+    of(ICBinOp, operator, _, left, right) {
+      if (is_float(*left)) {
+        write_float_compare(out, *operator, *left, *right);
+        emit(out, operand("j%s", float_condition_code(*operator, 1)), target, NULL);
+        if (MATCHES(*operator, EqualsOperator)) {
+          emit(out, "jp", target, NULL);
+        }
+        return;
+      }
+
+      const char* first = location(out, *left);
+      if (!is_register(first)) {
+        emit(out, "mov", first, "%r10d");
+        first = "%r10d";
+      }
+      emit(out, "cmp", location(out, *right), first);
+      emit(out, operand("j%s", condition_code(*operator, 1)), target, NULL);
+    }
+    otherwise { }
+  }
 }
 
-void write_intermediary_code(IntermediaryCode* code, FILE* out) {
-  while (code != NULL) {
-    if (code->label != NULL) {
-      string(code->label);
-      string(": ");
+typedef struct Move {
+  const char* destination;
+  const char* source;
+} Move;
+
+// Performs every move as if they happened at the same time: a register is only overwritten once nobody still has to
+// read it, and cycles are broken by parking one value in %r10d. %r11d carries moves from memory to memory. Floats only
+// move between the argument registers %xmm0 to %xmm7 and memory or the allocated XMM registers, so never in a cycle
+static void write_parallel_moves(AsmCode* out, Move* moves, int count) {
+  while (count > 0) {
+    int progress = 0;
+    for (int m = 0; m < count; m++) {
+      int blocked = 0;
+      for (int other = 0; other < count; other++) {
+        blocked = blocked || (other != m && strcmp(moves[other].source, moves[m].destination) == 0);
+      }
+      if (blocked) {
+        continue;
+      }
+
+      if (is_register(moves[m].source) || is_register(moves[m].destination)) {
+        emit(out, move_mnemonic(moves[m].source, moves[m].destination), moves[m].source, moves[m].destination);
+      } else {
+        emit(out, "mov", moves[m].source, "%r11d");
+        emit(out, "mov", "%r11d", moves[m].destination);
+      }
+      moves[m--] = moves[--count]; // Look at whatever took its place
+      progress = 1;
+    }
+
+    if (!progress) {
+      const char* parked = moves[0].destination;
+      emit(out, "mov", parked, "%r10d");
+      for (int m = 0; m < count; m++) {
+        if (strcmp(moves[m].source, parked) == 0) {
+          moves[m].source = "%r10d";
+        }
+      }
     }
+  }
+}
 
-    match(code->instruction) {
+// Sets up the frame and moves the arguments where the allocator wants the parameters. Calls need %rsp 16 byte aligned,
+// and it's 8 off on entry because of the return address
+static void write_prologue(IntermediaryCode* code, AsmCode* out, int begin, Identifier function) {
+  out->frame = &out->allocation->frames[function];
+  out->slot_operands = arena_alloc(&asm_arena, out->frame->slot_count * sizeof(const char*));
+  memset(out->slot_operands, 0, out->frame->slot_count * sizeof(const char*));
+  int saved = __builtin_popcount(out->frame->saved_registers);
+
+  if (out->frame->has_frame_pointer) {
+    emit(out, "pushq", "%rbp", NULL);
+    emit(out, "movq", "%rsp", "%rbp");
+  }
+  for (int r = 0; r < REGISTER_COUNT; r++) {
+    if (out->frame->saved_registers & (1u << r)) {
+      emit(out, "pushq", registers[r].quadword, NULL);
+    }
+  }
+  if (out->frame->has_frame_pointer) {
+    int size = (4 * out->frame->slot_count + 15) / 16 * 16 + (saved % 2) * 8;
+    if (size > 0) {
+      emit(out, "subq", operand("$%d", size), "%rsp");
+    }
+  }
+
+  int count = out->frame->parameter_count;
+  Storage parameters[count + 1];
+  for (int p = 0; p < count; p++) {
+    parameters[p] = *ic_definition(&code->instructions[begin + 1 + p].instruction);
+  }
+  Move moves[count + 1];
+  for (int p = 0; p < count; p++) {
+    int stack_index;
+    const char* argument = argument_register(parameters, p, &stack_index);
+    moves[p].destination = location(out, parameters[p]);
+    moves[p].source = argument != NULL ? argument : operand("%d(%%rbp)", 16 + 8 * stack_index);
+  }
+  write_parallel_moves(out, moves, count);
+}
+
+static void write_epilogue(AsmCode* out) {
+  int saved = __builtin_popcount(out->frame->saved_registers);
+  if (out->frame->has_frame_pointer) {
+    if (saved > 0) {
+      emit(out, "leaq", operand("-%d(%%rbp)", 8 * saved), "%rsp");
+    } else {
+      emit(out, "movq", "%rbp", "%rsp");
+    }
+  }
+  for (int r = REGISTER_COUNT - 1; r >= 0; r--) {
+    if (out->frame->saved_registers & (1u << r)) {
+      emit(out, "popq", registers[r].quadword, NULL);
+    }
+  }
+  if (out->frame->has_frame_pointer) {
+    emit(out, "popq", "%rbp", NULL);
+  }
+}
+
+// Arguments that don't fit in the registers of their kind go on the stack
+static void write_call(AsmCode* out, Identifier function, Storage dst) {
+  int count = out->argument_count;
+  int on_stack = 0;
+  for (int a = 0; a < count; a++) {
+    int stack_index;
+    on_stack += argument_register(out->arguments, a, &stack_index) == NULL;
+  }
+  int stack_size = (on_stack + on_stack % 2) * 8;
+  if (stack_size > 0) {
+    emit(out, "subq", operand("$%d", stack_size), "%rsp");
+    for (int a = 0; a < count; a++) {
+      int stack_index;
+      if (argument_register(out->arguments, a, &stack_index) != NULL) {
+        continue;
+      }
+      const char* source = location(out, out->arguments[a]);
+      const char* slot = operand("%d(%%rsp)", 8 * stack_index);
+      if (is_float_register(source)) {
+        emit(out, "movss", source, slot);
+      } else {
+        emit(out, "mov", source, "%r10d");
+        emit(out, "mov", "%r10d", slot);
+      }
+    }
+  }
+
+  Move moves[count + 1];
+  int register_count = 0;
+  for (int a = 0; a < count; a++) {
+    int stack_index;
+    const char* argument = argument_register(out->arguments, a, &stack_index);
+    if (argument != NULL) {
+      moves[register_count++] = (Move) { .destination = argument, .source = location(out, out->arguments[a]) };
+    }
+  }
+  write_parallel_moves(out, moves, register_count);
+  out->argument_count = 0;
+
+  emit(out, "callq", string_of(function), NULL);
+  if (stack_size > 0) {
+    emit(out, "addq", operand("$%d", stack_size), "%rsp");
+  }
+  // Floats come back in %xmm0
+  if (is_float(dst)) {
+    write_move(out, "%xmm0", location(out, dst));
+  } else {
+    emit(out, "mov", "%eax", location(out, dst));
+  }
+}
+
+void write_intermediary_code(IntermediaryCode* code, AsmCode* out) {
+  for (int i = 0; i < code->size; i++) {
+    ICInstruction* current = &code->instructions[i];
+
+    if (current->label != NO_STRING) {
+      emit_label(out, current->label);
+    }
+
+    if (is_fused_comparison(code, out, i)) {
+      write_fused_comparison(out, &current->instruction, &code->instructions[i + 1].instruction);
+      i++;
+      continue;
+    }
+
+    if (is_float_operation(&current->instruction)) {
+      write_float_operation(out, &current->instruction);
+      continue;
+    }
+
+    match(current->instruction) {
       of(ICNoop) { }
       of(ICFunctionBegin, name) {
-        string(*name);
-        string(": ");
+        emit_label(out, *name);
+        write_prologue(code, out, i, *name);
       }
-      of(ICFunctionEnd) string("retq # Function end\n\n");
-      of(ICJump, label) fprintf(out, "jmp %s\n", *label);
-      of(ICJumpIfFalse, storage, label) {
-        write_mov(out, *storage, "%r10d");
-        fprintf(out, "test %%r10d, %%r10d\n");
-        fprintf(out, "je %s\n", *label);
+      of(ICParameter, _) { } // Moved by the prologue
+      of(ICFunctionEnd) {
+        write_epilogue(out);
+        emit_comment(out, "retq", NULL, NULL, "Function end");
+        emit(out, NULL, NULL, NULL);
       }
-      of(ICCopy, dst, src) {
-        write_mov(out, *src, "%r10d");
-        write_mov(out, "%r10d", *dst);
+      of(ICJump, label) emit(out, "jmp", string_of(*label), NULL);
+      of(ICJumpIfFalse, storage, label) {
+        const char* condition = location(out, *storage);
+        if (!is_register(condition)) {
+          emit(out, "mov", condition, "%r10d");
+          condition = "%r10d";
+        }
+        emit(out, "test", condition, condition);
+        emit(out, "je", string_of(*label), NULL);
       }
+      of(ICCopy, dst, src) write_move(out, location(out, *src), location(out, *dst));
       of(ICCopyAt, dst, idx, src) {
-        fprintf(out, "mov $%s, %%r10d\n", *dst);
-        fprintf(out, "mov %s, %%r11d\n", *idx);
-        fprintf(out, "mov %s, %%r11d(%%r10d)\n", *src);
+        const char* element = array_element(out, *dst, *idx);
+        const char* source = location(out, *src);
+        if (is_register(source)) {
+          emit(out, move_mnemonic(source, element), source, element);
+        } else if (is_literal(*src) && !is_float(*src)) {
+          emit(out, "movl", source, element); // Neither operand tells the size
+        } else {
+          emit(out, "mov", source, "%r10d");
+          emit(out, "mov", "%r10d", element);
+        }
       }
       of(ICCopyFrom, dst, src, idx) {
-        fprintf(out, "mov $%s, %%r10d\n", *src);
-        fprintf(out, "mov %s, %%r11d\n", *idx);
-        fprintf(out, "mov %%r11d(%%r10d)\n, %s", *dst);
+        const char* element = array_element(out, *src, *idx);
+        const char* destination = location(out, *dst);
+        if (is_register(destination)) {
+          emit(out, move_mnemonic(element, destination), element, destination);
+        } else {
+          emit(out, "mov", element, "%r10d");
+          emit(out, "mov", "%r10d", destination);
+        }
+      }
+      // Unsigned, so negative indices are out of range too
+      of(ICCheckBounds, index, length) {
+        int value;
+        if (!literal_value(*index, &value)) {
+          emit(out, "cmpl", operand("$%d", *length), location(out, *index));
+          emit(out, "jae", BOUNDS_ERROR, NULL);
+          out->checks_bounds = 1;
+        } else if (value < 0 || value >= *length) {
+          emit(out, "jmp", BOUNDS_ERROR, NULL);
+          out->checks_bounds = 1;
+        }
       }
-      of(ICCall, name, dst) {
-        fprintf(out, "pushq %%rbp\n"); // Setup a stack frame
-        fprintf(out, "callq %s\n", *name);
-        fprintf(out, "mov %%eax, %s\n", *dst); // TODO: Is this enough? Maybe we need per-type return values?
-        fprintf(out, "popq %%rbp\n");
+      // cvtsi2ss takes no immediates, and only writes the low part of its register. Clearing it first keeps it from
+      // waiting on the old value
+      of(ICConvert, dst, src) {
+        const char* destination = location(out, *dst);
+        const char* source = location(out, *src);
+        if (is_float(*dst)) {
+          if (is_literal(*src)) {
+            emit(out, "mov", source, "%r10d");
+            source = "%r10d";
+          }
+          const char* work = is_float_register(destination) ? destination : "%xmm0";
+          emit(out, "xorps", work, work);
+          emit(out, "cvtsi2ssl", source, work);
+          write_move(out, work, destination);
+        } else {
+          const char* work = is_register(destination) ? destination : "%r10d";
+          emit(out, "cvttss2si", source, work);
+          write_move(out, work, destination);
+        }
       }
+      of(ICArgument, src) {
+        if (out->argument_count == out->argument_capacity) {
+          int capacity = out->argument_capacity == 0 ? 8 : out->argument_capacity * 2;
+          out->arguments = arena_realloc(
+              &asm_arena, out->arguments, out->argument_capacity * sizeof(Storage), capacity * sizeof(Storage)
+          );
+          out->argument_capacity = capacity;
+        }
+        out->arguments[out->argument_count++] = *src;
+      }
+      of(ICCall, name, dst) write_call(out, *name, *dst);
       of(ICInput, type, dst) {
-        char* format = NULL;
+        const char* format = NULL;
         match(*type) {
-          of(IntegerType) format = "percent_d";
-          of(FloatType) format = "percent_f";
-          of(CharType) format = "percent_c";
+          of(IntegerType) format = "percent_d(%rip)";
+          of(FloatType) format = "percent_f(%rip)";
+          of(CharType) format = "percent_c(%rip)";
+        }
+        // %c only writes the low byte, whatever was left in the other three would still be read
+        if (MATCHES(*type, CharType)) {
+          emit(out, "movl", "$0", location(out, *dst));
         }
-        fprintf(out, "pushq %%rbp\n"); // Setup a stack frame
-        fprintf(out, "leaq %s(%%rip), %%rdi\n", format);
-        fprintf(out, "movq %s@GOTPCREL(%%rip), %%rsi\n", *dst);
-        fprintf(out, "movb $0, %%al\n");
-        fprintf(out, "callq __isoc99_scanf@PLT\n");
-        fprintf(out, "popq %%rbp\n");
+        emit(out, "leaq", format, "%rdi");
+        if (is_local(*dst)) {
+          emit(out, "leaq", location(out, *dst), "%rsi");
+        } else {
+          emit(out, "movq", operand("%s@GOTPCREL(%%rip)", string_of(*dst)), "%rsi");
+        }
+        emit(out, "movb", "$0", "%al");
+        emit(out, "callq", "__isoc99_scanf@PLT", NULL);
       }
+      // Nothing to format, fputs just copies the string into stdout's buffer. Like every storage used to be, the
+      // operand is printed from memory: the allocator keeps it out of registers, and literals get a terminated copy
+      // on the stack
       of(ICPrint, src) {
-        fprintf(out, "pushq %%rbp\n"); // Setup a stack frame
-        fprintf(out, "leaq percent_s(%%rip), %%rdi\n");
-        fprintf(out, "leaq %s(%%rip), %%rsi\n", *src);
-        fprintf(out, "movb $0, %%al\n");
-        fprintf(out, "callq printf@PLT\n");
-        fprintf(out, "popq %%rbp\n");
+        if (is_literal(*src)) {
+          emit(out, "mov", location(out, *src), "%r10d");
+          emit(out, "subq", "$16", "%rsp");
+          emit(out, "movl", "%r10d", "(%rsp)");
+          emit(out, "movl", "$0", "4(%rsp)");
+          emit(out, "movq", "%rsp", "%rdi");
+        } else if (is_local(*src)) {
+          emit(out, "leaq", location(out, *src), "%rdi");
+        } else {
+          emit(out, "leaq", operand("%s(%%rip)", string_of(*src)), "%rdi");
+        }
+        emit(out, "movq", "stdout@GOTPCREL(%rip)", "%rsi");
+        emit(out, "movq", "(%rsi)", "%rsi");
+        emit(out, "callq", "fputs@PLT", NULL);
+        if (is_literal(*src)) {
+          emit(out, "addq", "$16", "%rsp");
+        }
       }
       of(ICReturn, src) {
-        fprintf(out, "mov %s, %%eax\n", *src);
-        fprintf(out, "retq\n");
+        if (is_float(*src)) {
+          write_move(out, location(out, *src), "%xmm0");
+        } else {
+          emit(out, "mov", location(out, *src), "%eax");
+        }
+        write_epilogue(out);
+        emit(out, "retq", NULL, NULL);
       }
       of(ICBinOp, operator, dst, left, right) {
-        write_mov(out, *left, "%r10d");
+        Storage first = *left, second = *right;
+        int constant;
+        // Multiplying by a literal is cheaper with it on the right
+        if (MATCHES(*operator, MultiplicationOperator) && !literal_value(second, &constant) &&
+            literal_value(first, &constant)) {
+          first = *right;
+          second = *left;
+        }
+        int by_constant = literal_value(second, &constant);
+
+        // Compute straight into the destination's register, unless that would overwrite `right` before reading it
+        const char* destination = location(out, *dst);
+        const char* source = location(out, second);
+        const char* work = is_register(destination) && strcmp(destination, source) != 0 ? destination : "%r10d";
+
+        if (!MATCHES(*operator, DivisionOperator)) {
+          emit(out, "mov", location(out, first), work);
+        }
 
         match(*operator) {
-          of(SumOperator) fprintf(out, "add %s, %%r10d\n", *right);
-          of(SubtractionOperator) fprintf(out, "sub %s, %%r10d\n", *right);
-          of(MultiplicationOperator) fprintf(out, "imul %s, %%r10d\n", *right);
-          of(DivisionOperator) {
-            // FIXME: This is still leaving a leftover mov %r10d before it
-            fprintf(out, "mov %s, %%eax\n", *left);
-            fprintf(out, "cltd\n");
-            fprintf(out, "mov %s, %%r10d\n", *right);
-            fprintf(out, "idiv %%r10d\n");
-            fprintf(out, "mov %%eax, %%r10d\n");
-          }
-          of(LessThanOperator) {
-            fprintf(out, "mov %s, %%r11d\n", *right);
-            fprintf(out, "cmp %%r11d, %%r10d\n");
-            fprintf(out, "mov $0, %%eax\n");
-            fprintf(out, "setb %%al\n");
-            fprintf(out, "mov %%eax, %%r10d\n");
+          of(SumOperator) emit(out, "add", source, work);
+          of(SubtractionOperator) emit(out, "sub", source, work);
+          of(MultiplicationOperator) {
+            if (by_constant) {
+              write_multiplication_by(out, constant, work);
+            } else {
+              emit(out, "imul", source, work);
+            }
           }
-          of(GreaterThanOperator) {
-            fprintf(out, "mov %s, %%r11d\n", *right);
-            fprintf(out, "cmp %%r11d, %%r10d\n");
-            fprintf(out, "mov $0, %%eax\n");
-            fprintf(out, "seta %%al\n");
-            fprintf(out, "mov %%eax, %%r10d\n");
-          }
-          of(AndOperator) fprintf(out, "and %s, %%r10d\n", *right);
-          of(OrOperator) fprintf(out, "or %s, %%r10d\n", *right);
-          of(NotOperator) fprintf(out, "xor %s, %%r10d\n", *right);
-          of(LessOrEqualOperator) {
-            fprintf(out, "mov %s, %%r11d\n", *right);
-            fprintf(out, "cmp %%r11d, %%r10d\n");
-            fprintf(out, "mov $0, %%eax\n");
-            fprintf(out, "setle %%al\n");
-            fprintf(out, "mov %%eax, %%r10d\n");
-          }
-          of(GreaterOrEqualOperator) {
-            fprintf(out, "mov %s, %%r11d\n", *right);
-            fprintf(out, "cmp %%r11d, %%r10d\n");
-            fprintf(out, "mov $0, %%eax\n");
-            fprintf(out, "setge %%al\n");
-            fprintf(out, "mov %%eax, %%r10d\n");
-          };
-          of(EqualsOperator) {
-            fprintf(out, "mov %s, %%r11d\n", *right);
-            fprintf(out, "cmp %%r11d, %%r10d\n");
-            fprintf(out, "mov $0, %%eax\n");
-            fprintf(out, "sete %%al\n");
-            fprintf(out, "mov %%eax, %%r10d\n");
+          of(DivisionOperator) {
+            if (by_constant && constant != 0 && constant != -1) {
+              write_division_by(out, location(out, first), constant, work);
+            } else {
+              emit(out, "mov", location(out, first), "%eax");
+              emit(out, "cltd", NULL, NULL);
+              emit(out, "mov", source, "%r10d");
+              emit(out, "idiv", "%r10d", NULL);
+              emit(out, "mov", "%eax", work);
+            }
           }
-          of(DiffersOperator) {
-            fprintf(out, "mov %s, %%r11d\n", *right);
-            fprintf(out, "cmp %%r11d, %%r10d\n");
-            fprintf(out, "mov $0, %%eax\n");
-            fprintf(out, "setne %%al\n");
-            fprintf(out, "mov %%eax, %%r10d\n");
-          };
+          of(LessThanOperator) write_comparison(out, *operator, source, work);
+          of(GreaterThanOperator) write_comparison(out, *operator, source, work);
+          of(AndOperator) emit(out, "and", source, work);
+          of(OrOperator) emit(out, "or", source, work);
+          of(NotOperator) emit(out, "xor", source, work);
+          of(LessOrEqualOperator) write_comparison(out, *operator, source, work);
+          of(GreaterOrEqualOperator) write_comparison(out, *operator, source, work);
+          of(EqualsOperator) write_comparison(out, *operator, source, work);
+          of(DiffersOperator) write_comparison(out, *operator, source, work);
         }
-        write_mov(out, "%r10d", *dst);
+        emit(out, "mov", work, destination);
       }
     }
+  }
 
-    code = code->next;
+  if (out->pending_label != NO_STRING) {
+    append_instruction(out, (AsmInstruction) { .mnemonic = NULL });
   }
 }
 
-void write_storage(IntermediaryCode* code, FILE* out) {
-  while (code != NULL) {
-    match(code->instruction) {
-      of(ICCall, name, dst) fprintf(out, "%s: .int 0\n", *dst);
-      of(ICInput, type, dst) fprintf(out, "%s: .int 0\n", *dst);
-      of(ICBinOp, operator, dst, left, right) fprintf(out, "%s: .int 0\n", *dst);
-      otherwise { }
+// Where failed bounds checks go, from anywhere in any function. stdout is flushed by exit, so whatever was printed
+// before still shows up
+static void write_bounds_error(AsmCode* out) {
+  emit_label(out, intern(BOUNDS_ERROR));
+  emit(out, "andq", "$-16", "%rsp");
+  emit(out, "leaq", BOUNDS_MESSAGE "(%rip)", "%rdi");
+  emit(out, "movq", "stderr@GOTPCREL(%rip)", "%rsi");
+  emit(out, "movq", "(%rsi)", "%rsi");
+  emit(out, "callq", "fputs@PLT", NULL);
+  emit(out, "mov", "$1", "%edi");
+  emit(out, "callq", "exit@PLT", NULL);
+  emit(out, NULL, NULL, NULL);
+}
+
+AsmCode* make_asm(IntermediaryCode* ic, RegisterAllocation* allocation) {
+  AsmCode* text = arena_alloc(&asm_arena, sizeof(AsmCode));
+  *text = (AsmCode) {
+    .instructions = NULL, .size = 0, .capacity = 0, .pending_label = NO_STRING, .allocation = allocation,
+    .checks_bounds = 0, .float_constants = NULL, .float_count = 0, .float_capacity = 0, .arguments = NULL,
+    .argument_count = 0, .argument_capacity = 0
+  };
+
+  text->use_count = arena_alloc(&asm_arena, interned_count() * sizeof(int));
+  memset(text->use_count, 0, interned_count() * sizeof(int));
+  for (int i = 0; i < ic->size; i++) {
+    Storage* uses[3];
+    int count = ic_uses(&ic->instructions[i].instruction, uses);
+    for (int u = 0; u < count; u++) {
+      text->use_count[*uses[u]]++;
     }
+  }
 
-    code = code->next;
+  write_intermediary_code(ic, text);
+  if (text->checks_bounds) {
+    write_bounds_error(text);
   }
-}
+  peephole(text);
 
-void write_asm(Program program, FILE* out) {
-  IntermediaryCode* ic = intemediary_code_from_program(program);
+  return text;
+}
 
+void write_asm(Program program, AsmCode* text, Output* out) {
   string(".global main\n");
   string("\n");
 
   string(".data\n");
   write_declarations(program.declarations, out);
   string("\n");
-  write_string_literals(out);
-  string("\n");
-  write_storage(ic, out);
-  string("\n");
-  string("percent_s: .asciz \"%s\"\n");
+
+  string(".section .rodata.str1.1,\"aMS\",@progbits,1\n");
+  write_string_literals(out, text->use_count);
   string("percent_d: .asciz \"%d\"\n");
   string("percent_f: .asciz \"%f\"\n");
   string("percent_c: .asciz \"%c\"\n");
+  if (text->checks_bounds) {
+    string(BOUNDS_MESSAGE ": .asciz \"error: array index out of bounds\\n\"\n");
+  }
+  string("\n");
+
+  if (text->float_count > 0) {
+    string(".section .rodata.cst4,\"aM\",@progbits,4\n");
+    string(".align 4\n");
+    for (int c = 0; c < text->float_count; c++) {
+      string(FLOAT_CONSTANTS);
+      integer(c);
+      string(": .long ");
+      integer((int)text->float_constants[c]);
+      string("\n");
+    }
+    string("\n");
+  }
+
+  string(".bss\n");
+  write_zeroed_arrays(program.declarations, out);
   string("\n");
 
   string(".text\n");
-  write_intermediary_code(ic, out);
+  write_instructions(text, out);
   string("\n");
 
   string(".section \".note.GNU-stack\",\"\",@progbits\n");
@@ -2,9 +2,16 @@
 #define ASM_H
 
 #include "intermediary-code.h"
+#include "output.h"
+#include "register-allocation.h"
 
-#include <stdio.h>
+typedef struct AsmCode AsmCode;
 
-void write_asm(Program, FILE*);
+extern Arena asm_arena;
+extern int movs_elided;
+
+// Lowers the IC into an optimized listing of the text section
+AsmCode* make_asm(IntermediaryCode*, RegisterAllocation*);
+void write_asm(Program, AsmCode*, Output*);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,332 @@
+#include "register-allocation.h"
+
+#include "asm.h"
+#include "cfg.h"
+#include "liveness.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+// %eax, %edx, %r10d and %r11d are left out, instruction selection uses them as scratch (and idiv needs the first two)
+const Register registers[REGISTER_COUNT] = {
+  { "%ecx", "%rcx", 0 },  { "%esi", "%rsi", 0 },  { "%edi", "%rdi", 0 },  { "%r8d", "%r8", 0 },
+  { "%r9d", "%r9", 0 },   { "%ebx", "%rbx", 1 },  { "%r12d", "%r12", 1 }, { "%r13d", "%r13", 1 },
+  { "%r14d", "%r14", 1 }, { "%r15d", "%r15", 1 },
+};
+
+const char* float_registers[FLOAT_REGISTER_COUNT] = { "%xmm8",  "%xmm9",  "%xmm10", "%xmm11",
+                                                      "%xmm12", "%xmm13", "%xmm14", "%xmm15" };
+
+const char* argument_registers[ARGUMENT_REGISTERS] = { "%edi", "%esi", "%edx", "%ecx", "%r8d", "%r9d" };
+const char* float_argument_registers[FLOAT_ARGUMENT_REGISTERS] = { "%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                                                                   "%xmm4", "%xmm5", "%xmm6", "%xmm7" };
+
+int temporaries_in_registers = 0;
+int temporaries_spilled = 0;
+int frame_slots = 0;
+
+// Positions interleave reads and writes: instruction i reads its operands at 2i and writes its result at 2i + 1, so a
+// temporary whose last use is the instruction defining another one can hand its register over
+typedef struct Interval {
+  Storage temporary;
+  int start;
+  int end;
+  int crosses_call; // Live while a call clobbers the caller-saved registers
+  int register_index;
+} Interval;
+
+static int by_start(const void* a, const void* b) {
+  const Interval* left = a;
+  const Interval* right = b;
+  return left->start != right->start ? left->start - right->start : left->end - right->end;
+}
+
+static void extend(Interval* interval, int position) {
+  if (position < interval->start) {
+    interval->start = position;
+  }
+  if (position > interval->end) {
+    interval->end = position;
+  }
+}
+
+// Ints and floats each take the registers of their kind in order, whatever doesn't fit goes on the stack in order
+const char* argument_register(Storage* arguments, int a, int* stack_index) {
+  int integers = 0, floats = 0;
+  *stack_index = 0;
+  for (int b = 0; b < a; b++) {
+    if (is_float(arguments[b])) {
+      *stack_index += floats++ >= FLOAT_ARGUMENT_REGISTERS;
+    } else {
+      *stack_index += integers++ >= ARGUMENT_REGISTERS;
+    }
+  }
+
+  if (is_float(arguments[a])) {
+    return floats < FLOAT_ARGUMENT_REGISTERS ? float_argument_registers[floats] : NULL;
+  }
+  return integers < ARGUMENT_REGISTERS ? argument_registers[integers] : NULL;
+}
+
+// Registers an interval can get: only float ones for floats, and only callee-saved ones when it lives across a call
+static int can_hold(int r, Interval* interval) {
+  if (is_float(interval->temporary)) {
+    return r >= REGISTER_COUNT && !interval->crosses_call;
+  }
+  return r < REGISTER_COUNT && (registers[r].callee_saved || !interval->crosses_call);
+}
+
+static int is_call(IC* instruction) {
+  return MATCHES(*instruction, ICCall) || MATCHES(*instruction, ICInput) || MATCHES(*instruction, ICPrint);
+}
+
+static Interval* build_intervals(
+    IntermediaryCode* code, FunctionCFG* function, FunctionLiveness* live, Liveness* liveness
+) {
+  Interval* intervals = arena_alloc(&asm_arena, live->temporary_count * sizeof(Interval));
+  for (int t = 0; t < live->temporary_count; t++) {
+    intervals[t] =
+        (Interval) { .temporary = live->temporaries[t], .start = INT_MAX, .end = -1, .register_index = -1 };
+  }
+
+  for (int b = 0; b < function->block_count; b++) {
+    BasicBlock* block = &function->blocks[b];
+    for (int t = 0; t < live->temporary_count; t++) {
+      if (SET_CONTAINS(live->live_in[b], t)) {
+        extend(&intervals[t], 2 * block->first);
+      }
+      if (SET_CONTAINS(live->live_out[b], t)) {
+        extend(&intervals[t], 2 * block->last);
+      }
+    }
+
+    for (int i = block->first; i < block->last; i++) {
+      IC* instruction = &code->instructions[i].instruction;
+
+      Storage* uses[3];
+      int use_count = ic_uses(instruction, uses);
+      for (int u = 0; u < use_count; u++) {
+        int index = temporary_index(liveness, *uses[u]);
+        if (index != -1) {
+          extend(&intervals[index], 2 * i);
+        }
+      }
+
+      Storage* definition = ic_definition(instruction);
+      int index = definition == NULL ? -1 : temporary_index(liveness, *definition);
+      if (index != -1) {
+        extend(&intervals[index], 2 * i + 1);
+      }
+    }
+  }
+
+  // Parameters are all written by the prologue at once, so they must not share registers or slots among themselves
+  int last_parameter = function->begin;
+  while (MATCHES(code->instructions[last_parameter + 1].instruction, ICParameter)) {
+    last_parameter++;
+  }
+  for (int i = function->begin + 1; i <= last_parameter; i++) {
+    int index = temporary_index(liveness, *ic_definition(&code->instructions[i].instruction));
+    extend(&intervals[index], 2 * function->begin + 1);
+    extend(&intervals[index], 2 * last_parameter + 1);
+  }
+
+  // calls_before[i]: how many calls there are in the function before instruction i
+  int length = function->end - function->begin + 1;
+  int* calls_before = arena_alloc(&asm_arena, (length + 1) * sizeof(int));
+  calls_before[0] = 0;
+  for (int i = 0; i < length; i++) {
+    calls_before[i + 1] = calls_before[i] + is_call(&code->instructions[function->begin + i].instruction);
+  }
+
+  for (int t = 0; t < live->temporary_count; t++) {
+    Interval* interval = &intervals[t];
+    // Calls at instruction p clobber at 2p + 1, look for one with start < 2p + 1 < end
+    int first_call = interval->start / 2 + interval->start % 2;
+    int last_call = (interval->end - 2) / 2;
+    if (interval->end >= 2 && first_call <= last_call) {
+      interval->crosses_call = calls_before[last_call + 1 - function->begin] > calls_before[first_call - function->begin];
+    }
+  }
+
+  return intervals;
+}
+
+// Frame slots that can be handed from one local to the next. `free_after` is the end of the current holder's interval,
+// so a slot is free for any interval starting after it
+static int take_slot(int* free_after, int* count, Interval* interval) {
+  for (int s = 0; s < *count; s++) {
+    if (free_after[s] < interval->start) {
+      free_after[s] = interval->end;
+      return s;
+    }
+  }
+
+  free_after[*count] = interval->end;
+  frame_slots++;
+  return (*count)++;
+}
+
+static int assign_slots(Interval* intervals, int count, RegisterAllocation* allocation) {
+  int* free_after = arena_alloc(&asm_arena, count * sizeof(int));
+  int slot_count = 0;
+  for (int t = 0; t < count; t++) {
+    Interval* interval = &intervals[t];
+    if (interval->register_index == -1 && interval->end != -1) {
+      allocation->slot_of[interval->temporary] = take_slot(free_after, &slot_count, interval);
+    }
+  }
+  return slot_count;
+}
+
+static void assign_registers(
+    IntermediaryCode* code, FunctionCFG* function, FunctionLiveness* live, Liveness* liveness, Interval* intervals,
+    Frame* frame
+) {
+  // scanf writes through a pointer and fputs reads through one, so whatever they get the address of has to stay in
+  // memory
+  char* in_memory = arena_alloc(&asm_arena, live->temporary_count);
+  memset(in_memory, 0, live->temporary_count);
+  for (int i = function->begin; i < function->end; i++) {
+    Storage* addressed = NULL;
+    match(code->instructions[i].instruction) {
+      of(ICInput, _, dst) addressed = dst;
+      of(ICPrint, src) addressed = src;
+      otherwise { }
+    }
+    int index = addressed == NULL ? -1 : temporary_index(liveness, *addressed);
+    if (index != -1) {
+      in_memory[index] = 1;
+    }
+  }
+
+  // Indices into `intervals` of the ones currently holding each register, -1 when it's free
+  int holder[REGISTER_COUNT + FLOAT_REGISTER_COUNT];
+  for (int r = 0; r < REGISTER_COUNT + FLOAT_REGISTER_COUNT; r++) {
+    holder[r] = -1;
+  }
+
+  for (int t = 0; t < live->temporary_count; t++) {
+    Interval* current = &intervals[t];
+    if (in_memory[temporary_index(liveness, current->temporary)] || current->end == -1) {
+      continue;
+    }
+
+    // Expire the intervals that ended before this one starts
+    for (int r = 0; r < REGISTER_COUNT + FLOAT_REGISTER_COUNT; r++) {
+      if (holder[r] != -1 && intervals[holder[r]].end < current->start) {
+        holder[r] = -1;
+      }
+    }
+
+    // Caller-saved registers are free to use but die on calls, callee-saved ones cost a push and a pop
+    int chosen = -1;
+    for (int r = 0; r < REGISTER_COUNT + FLOAT_REGISTER_COUNT && chosen == -1; r++) {
+      if (holder[r] == -1 && can_hold(r, current)) {
+        chosen = r;
+      }
+    }
+
+    // Under pressure, spill whichever interval ends last
+    if (chosen == -1) {
+      int victim = -1;
+      for (int r = 0; r < REGISTER_COUNT + FLOAT_REGISTER_COUNT; r++) {
+        if (can_hold(r, current) &&
+            (victim == -1 || intervals[holder[r]].end > intervals[holder[victim]].end)) {
+          victim = r;
+        }
+      }
+
+      if (victim == -1 || intervals[holder[victim]].end <= current->end) {
+        continue;
+      }
+      intervals[holder[victim]].register_index = -1;
+      chosen = victim;
+    }
+
+    current->register_index = chosen;
+    holder[chosen] = t;
+  }
+
+  for (int t = 0; t < live->temporary_count; t++) {
+    Interval* interval = &intervals[t];
+    if (interval->register_index == -1) {
+      temporaries_spilled++;
+    } else {
+      temporaries_in_registers++;
+      if (interval->register_index < REGISTER_COUNT && registers[interval->register_index].callee_saved) {
+        frame->saved_registers |= 1u << interval->register_index;
+      }
+    }
+  }
+}
+
+static void allocate_function(
+    IntermediaryCode* code, FunctionCFG* function, FunctionLiveness* live, Liveness* liveness, int use_registers,
+    RegisterAllocation* allocation
+) {
+  Interval* intervals = build_intervals(code, function, live, liveness);
+  qsort(intervals, live->temporary_count, sizeof(Interval), by_start);
+
+  Frame* frame = &allocation->frames[function->name];
+  int is_leaf = 1;
+  for (int i = function->begin; i < function->end; i++) {
+    IC* instruction = &code->instructions[i].instruction;
+    is_leaf = is_leaf && !is_call(instruction);
+    frame->parameter_count += MATCHES(*instruction, ICParameter);
+  }
+  Storage parameters[frame->parameter_count + 1];
+  for (int p = 0; p < frame->parameter_count; p++) {
+    parameters[p] = *ic_definition(&code->instructions[function->begin + 1 + p].instruction);
+  }
+  for (int p = 0; p < frame->parameter_count; p++) {
+    int stack_index;
+    frame->stack_parameters += argument_register(parameters, p, &stack_index) == NULL;
+  }
+
+  if (use_registers) {
+    assign_registers(code, function, live, liveness, intervals, frame);
+  }
+  frame->slot_count = assign_slots(intervals, live->temporary_count, allocation);
+
+  // Leaf functions can keep their slots in the red zone, the 128 bytes below %rsp nobody else touches
+  frame->has_frame_pointer = !is_leaf || frame->slot_count * 4 > 128 || frame->stack_parameters > 0;
+
+  for (int t = 0; t < live->temporary_count; t++) {
+    allocation->register_of[intervals[t].temporary] = intervals[t].register_index;
+  }
+}
+
+
+RegisterAllocation* allocate_registers(IntermediaryCode* code, int use_registers) {
+  CFG* cfg = make_cfg(code);
+  Liveness* liveness = analyze_liveness(code, cfg);
+
+  RegisterAllocation* allocation = arena_alloc(&asm_arena, sizeof(RegisterAllocation));
+  allocation->size = interned_count();
+  allocation->register_of = arena_alloc(&asm_arena, allocation->size * sizeof(int));
+  memset(allocation->register_of, 0xff, allocation->size * sizeof(int));
+  allocation->slot_of = arena_alloc(&asm_arena, allocation->size * sizeof(int));
+  memset(allocation->slot_of, 0xff, allocation->size * sizeof(int));
+  allocation->frames = arena_alloc(&asm_arena, allocation->size * sizeof(Frame));
+  memset(allocation->frames, 0, allocation->size * sizeof(Frame));
+
+  for (int f = 0; f < cfg->function_count; f++) {
+    allocate_function(code, &cfg->functions[f], &liveness->functions[f], liveness, use_registers, allocation);
+  }
+
+  return allocation;
+}
+
+const char* register_of(RegisterAllocation* allocation, Storage storage) {
+  if (storage >= allocation->size || allocation->register_of[storage] == -1) {
+    return NULL;
+  }
+  int index = allocation->register_of[storage];
+  return index < REGISTER_COUNT ? registers[index].name : float_registers[index - REGISTER_COUNT];
+}
+
+int slot_of(RegisterAllocation* allocation, Storage storage) {
+  return storage < allocation->size ? allocation->slot_of[storage] : -1;
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+#ifndef REGISTER_ALLOCATION_H
+#define REGISTER_ALLOCATION_H
+
+#include "intermediary-code.h"
+
+typedef struct Register {
+  const char* name;     // 32 bit view, the one instructions use
+  const char* quadword; // For pushq and popq
+  int callee_saved;
+} Register;
+
+#define REGISTER_COUNT 10
+extern const Register registers[REGISTER_COUNT];
+
+// Floats get the XMM registers no argument is passed in. System V has no callee-saved ones, so nothing in them
+// survives a call
+#define FLOAT_REGISTER_COUNT 8
+extern const char* float_registers[FLOAT_REGISTER_COUNT];
+
+// System V: the first six int arguments and the first eight float ones go in registers, the rest on the stack
+#define ARGUMENT_REGISTERS       6
+#define FLOAT_ARGUMENT_REGISTERS 8
+extern const char* argument_registers[ARGUMENT_REGISTERS];
+extern const char* float_argument_registers[FLOAT_ARGUMENT_REGISTERS];
+
+// Per-call storage of one function
+typedef struct Frame {
+  unsigned saved_registers; // Bitmask over `registers` of the callee-saved ones it has to preserve
+  int slot_count;           // 4 byte slots for the locals that live in memory
+  int has_frame_pointer;    // Leaf functions whose slots fit in the red zone don't set up %rbp
+  int parameter_count;
+  int stack_parameters;     // Passed by the caller on the stack instead of in registers
+} Frame;
+
+typedef struct RegisterAllocation {
+  int* register_of; // Indexed by StringId: index into `registers`, or REGISTER_COUNT plus one into `float_registers`,
+                    // of each local that got one, -1 for the rest
+  int* slot_of;     // Indexed by StringId: frame slot of each local kept in memory, -1 for the rest
+  Frame* frames;    // Indexed by the function's StringId
+  uint32_t size;
+} RegisterAllocation;
+
+extern int temporaries_in_registers;
+extern int temporaries_spilled;
+extern int frame_slots;
+
+// Linear scan over the live ranges of the locals (temporaries and local variables), then whatever is left in memory is
+// packed into as few frame slots as possible. Without `use_registers` only the packing happens. Lives in asm_arena
+RegisterAllocation* allocate_registers(IntermediaryCode* code, int use_registers);
+
+// Register argument `a` of `arguments` is passed in, or NULL when it goes on the stack. Then `stack_index` is its
+// position among the ones on the stack
+const char* argument_register(Storage* arguments, int a, int* stack_index);
+
+// The register holding `storage`, or NULL when it lives in memory
+const char* register_of(RegisterAllocation* allocation, Storage storage);
+// The frame slot holding `storage`, or -1 when it's in a register or isn't a local
+int slot_of(RegisterAllocation* allocation, Storage storage);
+
+#endif
\ No newline at end of file
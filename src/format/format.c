@@ -2,24 +2,38 @@
 
 #define TAB_SIZE 2
 
-#define space()      fprintf(out, " ")
-#define tabs(n)      fprintf(out, "%*s", (n)*TAB_SIZE, "")
-#define character(c) fprintf(out, "%c", c)
-#define string(s)    fprintf(out, "%s", s)
-#define integer(i)   fprintf(out, "%d", i)
+#define space()      output_char(out, ' ')
+#define tabs(n)      indent(out, (n)*TAB_SIZE)
+#define character(c) output_char(out, c)
+#define string(s)    output_string(out, s)
+#define integer(i)   output_int(out, i)
+
+static void indent(Output* out, int width) {
+  while (width-- > 0) {
+    space();
+  }
+}
 
-static void print_literal(FILE* out, Literal literal) {
+static void print_literal(Output* out, Literal literal) {
   match(literal) {
-    of(IntLiteral, i) fprintf(out, "%d", *i);
-    of(FloatLiteral, f) fprintf(out, "%g", *f);
-    of(CharLiteral, c) fprintf(out, "'%c'", *c);
-    of(StringLiteral, s) fprintf(out, "\"%s\"", *s);
+    of(IntLiteral, i) integer(*i);
+    of(FloatLiteral, f) output_float(out, *f);
+    of(CharLiteral, c) {
+      character('\'');
+      character(*c);
+      character('\'');
+    }
+    of(StringLiteral, s) {
+      character('"');
+      string(*s);
+      character('"');
+    }
   }
 }
 
-void print_identifier(FILE* out, Identifier identifier) { string(identifier); }
+void print_identifier(Output* out, Identifier identifier) { string(string_of(identifier)); }
 
-static void print_type(FILE* out, Type type) {
+static void print_type(Output* out, Type type) {
   match(type) {
     of(IntegerType) string("int");
     of(FloatType) string("float");
@@ -27,7 +41,7 @@ static void print_type(FILE* out, Type type) {
   }
 }
 
-void print_operator(FILE* out, BinaryOperator operator) {
+void print_operator(Output* out, BinaryOperator operator) {
   match(operator) {
     of(SumOperator) string("+");
     of(SubtractionOperator) string("-");
@@ -45,10 +59,10 @@ void print_operator(FILE* out, BinaryOperator operator) {
   }
 }
 
-void print_expression(FILE* out, Expression expression);
+void print_expression(Output* out, Expression expression);
 
 // TODO: Tears come out of my eyes everytime I look at this horrible code
-void print_operation_with_precedence(FILE* out, BinaryOperator operator, Expression left, Expression right) {
+void print_operation_with_precedence(Output* out, BinaryOperator operator, Expression left, Expression right) {
   int is_high_precedence = MATCHES(operator, MultiplicationOperator) || MATCHES(operator, DivisionOperator);
 
   char* left_prefix = "";
@@ -90,7 +104,7 @@ void print_operation_with_precedence(FILE* out, BinaryOperator operator, Express
   string(right_postfix);
 }
 
-void print_argument_list(FILE* out, ArgumentList* arguments) {
+void print_argument_list(Output* out, ArgumentList* arguments) {
   if (arguments == NULL) {
     return;
   }
@@ -102,7 +116,7 @@ void print_argument_list(FILE* out, ArgumentList* arguments) {
   }
 }
 
-void print_expression(FILE* out, Expression expression) {
+void print_expression(Output* out, Expression expression) {
   match(expression) {
     of(LiteralExpression, lit) print_literal(out, *lit);
     of(IdentifierExpression, name) print_identifier(out, *name);
@@ -127,9 +141,9 @@ void print_expression(FILE* out, Expression expression) {
   }
 }
 
-void print_statement(FILE* out, Statement statement, int level);
+void print_statement(Output* out, Statement statement, int level);
 
-void print_block_statement(FILE* out, StatementList* body, int level) {
+void print_block_statement(Output* out, StatementList* body, int level) {
   if (body == NULL) {
     string("{ }");
     return;
@@ -146,7 +160,7 @@ void print_block_statement(FILE* out, StatementList* body, int level) {
   string("}");
 }
 
-void print_statement(FILE* out, Statement statement, int level) {
+void print_statement(Output* out, Statement statement, int level) {
   match(statement) {
     of(AssignmentStatement, name, expr) {
       print_identifier(out, *name);
@@ -198,7 +212,7 @@ void print_statement(FILE* out, Statement statement, int level) {
   }
 }
 
-void print_parameters_declaration(FILE* out, ParametersDeclaration* params) {
+void print_parameters_declaration(Output* out, ParametersDeclaration* params) {
   if (params == NULL) {
     return;
   }
@@ -212,7 +226,7 @@ void print_parameters_declaration(FILE* out, ParametersDeclaration* params) {
   }
 }
 
-void print_array_initialization(FILE* out, ArrayInitialization* values) {
+void print_array_initialization(Output* out, ArrayInitialization* values) {
   if (values == NULL) {
     return;
   }
@@ -224,7 +238,7 @@ void print_array_initialization(FILE* out, ArrayInitialization* values) {
   }
 }
 
-void print_variable_declaration(FILE* out, Type type, Identifier name, Literal value) {
+void print_variable_declaration(Output* out, Type type, Identifier name, Literal value) {
   print_type(out, type);
   space();
   print_identifier(out, name);
@@ -233,7 +247,7 @@ void print_variable_declaration(FILE* out, Type type, Identifier name, Literal v
   string(";\n");
 }
 
-void print_function_declaration(FILE* out, Type type, Identifier name, ParametersDeclaration* params) {
+void print_function_declaration(Output* out, Type type, Identifier name, ParametersDeclaration* params) {
   print_type(out, type);
   space();
   print_identifier(out, name);
@@ -245,11 +259,13 @@ void print_function_declaration(FILE* out, Type type, Identifier name, Parameter
   string(";\n");
 }
 
-void print_array_declaration(FILE* out, Type type, Identifier name, int size, ArrayInitialization* values) {
+void print_array_declaration(Output* out, Type type, Identifier name, int size, ArrayInitialization* values) {
   print_type(out, type);
   space();
   print_identifier(out, name);
-  fprintf(out, "[%d]", size);
+  character('[');
+  integer(size);
+  character(']');
   if (values != NULL) {
     space();
     print_array_initialization(out, values);
@@ -257,7 +273,7 @@ void print_array_declaration(FILE* out, Type type, Identifier name, int size, Ar
   string(";\n");
 }
 
-void print_declarations(FILE* out, DeclarationList* declarations) {
+void print_declarations(Output* out, DeclarationList* declarations) {
   if (declarations == NULL) {
     return;
   }
@@ -273,7 +289,7 @@ void print_declarations(FILE* out, DeclarationList* declarations) {
   print_declarations(out, declarations->next);
 }
 
-void print_implementations(FILE* out, ImplementationList* implementations) {
+void print_implementations(Output* out, ImplementationList* implementations) {
   if (implementations == NULL) {
     return;
   }
@@ -284,7 +300,7 @@ void print_implementations(FILE* out, ImplementationList* implementations) {
   print_statement(out, implementations->implementation.body, 0);
 }
 
-void print_program(FILE* out, Program program) {
+void print_program(Output* out, Program program) {
   print_declarations(out, program.declarations);
   print_implementations(out, program.implementations);
 }
\ No newline at end of file
@@ -1,10 +1,9 @@
 #ifndef FORMAT_H
 #define FORMAT_H
 
+#include "output.h"
 #include "syntax-tree.h"
 
-#include <stdio.h>
-
-void print_program(FILE* out, Program program);
+void print_program(Output* out, Program program);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,428 @@
+#include "cfg.h"
+#include "optimizations.h"
+
+#include <limits.h>
+#include <string.h>
+
+int bounds_checks_removed = 0;
+
+// Deep enough for an index computed from a few induction variables of nested loops
+#define RANGE_DEPTH 16
+
+static void* make_array(int count, size_t size) {
+  void* array = arena_alloc(&intermediary_code_arena, count * size);
+  memset(array, 0, count * size);
+  return array;
+}
+
+void insert_bounds_checks(IntermediaryCode* code, Program* program) {
+  int* length_of = make_array(interned_count(), sizeof(int));
+  for (DeclarationList* declarations = program->declarations; declarations != NULL;
+       declarations = declarations->next) {
+    match(declarations->declaration) {
+      of(ArrayDeclaration, _, identifier, size, _) length_of[*identifier] = *size;
+      otherwise { }
+    }
+  }
+
+  IntermediaryCode* result = arena_alloc(&intermediary_code_arena, sizeof(IntermediaryCode));
+  *result = (IntermediaryCode) { .instructions = NULL, .size = 0, .capacity = 0 };
+  for (int i = 0; i < code->size; i++) {
+    ICInstruction* current = &code->instructions[i];
+    Storage array = NO_STRING, index = NO_STRING;
+    match(current->instruction) {
+      of(ICCopyAt, dst, position, _) {
+        array = *dst;
+        index = *position;
+      }
+      of(ICCopyFrom, _, src, position) {
+        array = *src;
+        index = *position;
+      }
+      otherwise { }
+    }
+
+    // The check takes over the label, jumping to the access has to go through it
+    Label label = current->label;
+    if (array != NO_STRING) {
+      append_ic(result, ICCheckBounds(index, length_of[array]));
+      result->instructions[result->size - 1].label = label;
+      label = NO_STRING;
+    }
+    append_ic(result, current->instruction);
+    result->instructions[result->size - 1].label = label;
+  }
+  *code = *result;
+}
+
+// Every value a storage can hold at some point. 64 bits, so computing the bounds of a sum can't wrap
+typedef struct Range {
+  long long low;
+  long long high;
+} Range;
+
+static const Range any = { INT_MIN, INT_MAX };
+
+// Anything past 32 bits wraps around at run time, which could give any value
+static Range fit(long long low, long long high) {
+  return low < INT_MIN || high > INT_MAX ? any : (Range) { low, high };
+}
+
+// `a operator b` is the same as `b mirrored(operator) a`
+static BinaryOperator mirrored(BinaryOperator operator) {
+  match(operator) {
+    of(LessThanOperator) return GreaterThanOperator();
+    of(GreaterThanOperator) return LessThanOperator();
+    of(LessOrEqualOperator) return GreaterOrEqualOperator();
+    of(GreaterOrEqualOperator) return LessOrEqualOperator();
+    otherwise return operator;
+  }
+  return operator;
+}
+
+// A variable the loop only moves by a constant step, and that its test keeps on one side of a bound
+typedef struct Induction {
+  int analyzed;
+  Storage variable;  // NO_STRING when the loop has none
+  int write;         // Index of its only write in the loop
+  Range before;      // Holds in the body, until the write
+  Range after;       // Holds everywhere else in the loop, the header included
+  char* after_write; // Per block: reachable from the write without going back through the header
+} Induction;
+
+typedef struct Analysis {
+  IntermediaryCode* code;
+  FunctionCFG* function;
+  uint32_t size;         // Names interned when the analysis started, the arrays below are that big
+  int* definitions;      // Per name, in the function
+  int* defined_at;       // Per name: index of its last definition
+  int* block_of;         // Per instruction, -1 for the ones outside any block
+  char** in_loop;        // Per loop, per block
+  Induction* inductions; // Per loop
+} Analysis;
+
+static Range range_at(Analysis* analysis, Storage storage, int at, int depth);
+
+// Whether the instruction at `first` runs before the one at `then` on every path that reaches `then`
+static int precedes(Analysis* analysis, int first, int then) {
+  int block = analysis->block_of[first];
+  int other = analysis->block_of[then];
+  if (block == -1 || other == -1) {
+    return 0;
+  }
+  return block == other ? first < then : dominates(analysis->function, block, other);
+}
+
+// Range of what the instruction at `definition` writes
+static Range defined_range(Analysis* analysis, int definition, int depth) {
+  match(analysis->code->instructions[definition].instruction) {
+    of(ICCopy, _, src) return range_at(analysis, *src, definition, depth);
+    of(ICBinOp, operator, _, left, right) {
+      Range l = range_at(analysis, *left, definition, depth);
+      Range r = range_at(analysis, *right, definition, depth);
+      match(*operator) {
+        of(SumOperator) return fit(l.low + r.low, l.high + r.high);
+        of(SubtractionOperator) return fit(l.low - r.high, l.high - r.low);
+        of(MultiplicationOperator) {
+          long long products[] = { l.low * r.low, l.low * r.high, l.high * r.low, l.high * r.high };
+          Range product = { products[0], products[0] };
+          for (int p = 1; p < 4; p++) {
+            product.low = products[p] < product.low ? products[p] : product.low;
+            product.high = products[p] > product.high ? products[p] : product.high;
+          }
+          return fit(product.low, product.high);
+        }
+        of(DivisionOperator) return any;
+        of(AndOperator) return any;
+        of(OrOperator) return any;
+        of(NotOperator) return any;
+        otherwise return (Range) { 0, 1 }; // Comparisons
+      }
+    }
+    otherwise return any;
+  }
+  return any;
+}
+
+// How many times the loop writes `storage`, with `write` set to the last one
+static int loop_writes(Analysis* analysis, Loop* loop, Storage storage, int* write) {
+  int count = 0;
+  for (int b = 0; b < loop->block_count; b++) {
+    BasicBlock* block = &analysis->function->blocks[loop->blocks[b]];
+    for (int i = block->first; i < block->last; i++) {
+      Storage* definition = ic_definition(&analysis->code->instructions[i].instruction);
+      if (definition != NULL && *definition == storage) {
+        *write = i;
+        count++;
+      }
+    }
+  }
+  return count;
+}
+
+// Step of `variable` when its only write in the loop is `v = v ± c`, or `v = t` with `t = v ± c`. 0 otherwise
+static int induction_step(Analysis* analysis, Loop* loop, Storage variable, int* write) {
+  if (!is_local(variable) || variable >= analysis->size || loop_writes(analysis, loop, variable, write) != 1) {
+    return 0;
+  }
+  int step = *write;
+  Storage stepped = variable;
+  match(analysis->code->instructions[*write].instruction) {
+    of(ICCopy, _, src) {
+      if (*src < analysis->size && is_local(*src) && analysis->definitions[*src] == 1) {
+        stepped = *src;
+        step = analysis->defined_at[*src];
+      }
+    }
+    otherwise { }
+  }
+  // The temporary has to be computed in the loop, on the way to the write
+  if (step != *write && (!precedes(analysis, step, *write) ||
+                         !analysis->in_loop[loop - analysis->function->loops][analysis->block_of[step]])) {
+    return 0;
+  }
+
+  int value = 0, constant;
+  match(analysis->code->instructions[step].instruction) {
+    of(ICBinOp, operator, dst, left, right) {
+      if (*dst == stepped && MATCHES(*operator, SumOperator)) {
+        if (*left == variable && literal_value(*right, &constant)) {
+          value = constant;
+        } else if (*right == variable && literal_value(*left, &constant)) {
+          value = constant;
+        }
+      } else if (*dst == stepped && MATCHES(*operator, SubtractionOperator) && *left == variable &&
+                 literal_value(*right, &constant) && constant != INT_MIN) {
+        value = -constant;
+      }
+    }
+    otherwise { }
+  }
+  return value;
+}
+
+// Range of `variable` on the way into the loop, from its last definition in the blocks that lead straight to it
+static Range entry_range(Analysis* analysis, Loop* loop, Storage variable, int depth) {
+  FunctionCFG* function = analysis->function;
+  BasicBlock* header = &function->blocks[loop->header];
+  int entry = -1;
+  for (int p = 0; p < header->predecessor_count; p++) {
+    if (!analysis->in_loop[loop - function->loops][header->predecessors[p]]) {
+      if (entry != -1) {
+        return any;
+      }
+      entry = header->predecessors[p];
+    }
+  }
+
+  for (int steps = 0; entry != -1 && steps < function->block_count; steps++) {
+    BasicBlock* block = &function->blocks[entry];
+    for (int i = block->last - 1; i >= block->first; i--) {
+      Storage* definition = ic_definition(&analysis->code->instructions[i].instruction);
+      if (definition != NULL && *definition == variable) {
+        return defined_range(analysis, i, depth);
+      }
+    }
+    entry = block->predecessor_count == 1 ? block->predecessors[0] : -1;
+  }
+  return any;
+}
+
+static void find_after_write(Analysis* analysis, Loop* loop, Induction* induction) {
+  FunctionCFG* function = analysis->function;
+  char* in_loop = analysis->in_loop[loop - function->loops];
+  int* worklist = make_array(function->block_count, sizeof(int));
+  int count = 0;
+  induction->after_write = make_array(function->block_count, sizeof(char));
+
+  worklist[count++] = analysis->block_of[induction->write];
+  while (count > 0) {
+    BasicBlock* block = &function->blocks[worklist[--count]];
+    for (int s = 0; s < block->successor_count; s++) {
+      int successor = block->successors[s];
+      if (in_loop[successor] && successor != loop->header && !induction->after_write[successor]) {
+        induction->after_write[successor] = 1;
+        worklist[count++] = successor;
+      }
+    }
+  }
+}
+
+// The header leaves the loop when a comparison of the variable against a bound is false. The bound may change, but
+// every time the body runs the variable was on the right side of what the bound could be. Between the entry and the
+// test, the variable only moves in one direction
+static Induction* analyze_induction(Analysis* analysis, int l, int depth) {
+  Induction* induction = &analysis->inductions[l];
+  if (induction->analyzed) {
+    return induction;
+  }
+  induction->analyzed = 1; // Anything asking again while this runs finds no variable
+
+  FunctionCFG* function = analysis->function;
+  Loop* loop = &function->loops[l];
+  BasicBlock* header = &function->blocks[loop->header];
+  char* in_loop = analysis->in_loop[l];
+  if (header->last == header->first || header->successor_count != 2 || loop->header + 1 >= function->block_count ||
+      !in_loop[loop->header + 1]) {
+    return induction;
+  }
+  Storage condition = NO_STRING;
+  match(analysis->code->instructions[header->last - 1].instruction) {
+    of(ICJumpIfFalse, storage, _) condition = *storage;
+    otherwise { }
+  }
+  for (int s = 0; s < 2; s++) {
+    if (header->successors[s] != loop->header + 1 && in_loop[header->successors[s]]) {
+      return induction;
+    }
+  }
+  if (condition == NO_STRING || condition >= analysis->size || analysis->definitions[condition] != 1 ||
+      analysis->block_of[analysis->defined_at[condition]] != loop->header) {
+    return induction;
+  }
+
+  int test = analysis->defined_at[condition];
+  match(analysis->code->instructions[test].instruction) {
+    of(ICBinOp, operator, _, left, right) {
+      for (int side = 0; side < 2 && induction->variable == NO_STRING; side++) {
+        Storage variable = side == 0 ? *left : *right;
+        Storage bound = side == 0 ? *right : *left;
+        int write;
+        int step = induction_step(analysis, loop, variable, &write);
+        if (step == 0) {
+          continue;
+        }
+
+        // As `variable <comparison> bound`, with the variable on the left
+        BinaryOperator comparison = side == 0 ? *operator : mirrored(*operator);
+        int below = MATCHES(comparison, LessThanOperator) || MATCHES(comparison, LessOrEqualOperator);
+        int above = MATCHES(comparison, GreaterThanOperator) || MATCHES(comparison, GreaterOrEqualOperator);
+        Range limit = range_at(analysis, bound, test, depth);
+        Range entry = entry_range(analysis, loop, variable, depth);
+
+        if (step > 0 && below) {
+          long long high = MATCHES(comparison, LessThanOperator) ? limit.high - 1 : limit.high;
+          if (high + step <= INT_MAX) {
+            induction->before = (Range) { entry.low, high };
+            induction->after = (Range) { entry.low, high + step > entry.high ? high + step : entry.high };
+            induction->variable = variable;
+            induction->write = write;
+          }
+        } else if (step < 0 && above) {
+          long long low = MATCHES(comparison, GreaterThanOperator) ? limit.low + 1 : limit.low;
+          if (low + step >= INT_MIN) {
+            induction->before = (Range) { low, entry.high };
+            induction->after = (Range) { low + step < entry.low ? low + step : entry.low, entry.high };
+            induction->variable = variable;
+            induction->write = write;
+          }
+        }
+      }
+    }
+    otherwise { }
+  }
+
+  if (induction->variable != NO_STRING) {
+    find_after_write(analysis, loop, induction);
+  }
+  return induction;
+}
+
+static Range range_at(Analysis* analysis, Storage storage, int at, int depth) {
+  int value;
+  if (literal_value(storage, &value)) {
+    return (Range) { value, value };
+  }
+  if (depth == 0 || storage >= analysis->size || !is_local(storage)) {
+    return any;
+  }
+
+  // Whatever its only definition wrote, as long as it ran first
+  if (analysis->definitions[storage] == 1 && precedes(analysis, analysis->defined_at[storage], at)) {
+    return defined_range(analysis, analysis->defined_at[storage], depth - 1);
+  }
+
+  // Innermost loops come last
+  FunctionCFG* function = analysis->function;
+  int block = analysis->block_of[at];
+  for (int l = function->loop_count - 1; l >= 0 && block != -1; l--) {
+    if (!analysis->in_loop[l][block]) {
+      continue;
+    }
+    Induction* induction = analyze_induction(analysis, l, depth - 1);
+    if (induction->variable == storage) {
+      int write_block = analysis->block_of[induction->write];
+      int after = block == function->loops[l].header || induction->after_write[block] ||
+                  (block == write_block && at > induction->write);
+      return after ? induction->after : induction->before;
+    }
+  }
+  return any;
+}
+
+void eliminate_bounds_checks(IntermediaryCode* code) {
+  int check_count = 0;
+  for (int i = 0; i < code->size; i++) {
+    check_count += MATCHES(code->instructions[i].instruction, ICCheckBounds);
+  }
+  if (check_count == 0) {
+    return;
+  }
+
+  CFG* cfg = make_cfg(code);
+  Analysis analysis = {
+    .code = code,
+    .size = interned_count(),
+    .block_of = make_array(code->size, sizeof(int)),
+  };
+  analysis.definitions = make_array(analysis.size, sizeof(int));
+  analysis.defined_at = make_array(analysis.size, sizeof(int));
+
+  for (int f = 0; f < cfg->function_count; f++) {
+    FunctionCFG* function = &cfg->functions[f];
+    analysis.function = function;
+    for (int i = function->begin; i <= function->end; i++) {
+      analysis.block_of[i] = -1;
+      Storage* definition = ic_definition(&code->instructions[i].instruction);
+      if (definition != NULL) {
+        analysis.definitions[*definition] = 0;
+      }
+    }
+    for (int b = 0; b < function->block_count; b++) {
+      for (int i = function->blocks[b].first; i < function->blocks[b].last; i++) {
+        analysis.block_of[i] = b;
+      }
+    }
+    for (int i = function->begin; i <= function->end; i++) {
+      Storage* definition = ic_definition(&code->instructions[i].instruction);
+      if (definition != NULL) {
+        analysis.definitions[*definition]++;
+        analysis.defined_at[*definition] = i;
+      }
+    }
+
+    analysis.in_loop = make_array(function->loop_count, sizeof(char*));
+    analysis.inductions = make_array(function->loop_count, sizeof(Induction));
+    for (int l = 0; l < function->loop_count; l++) {
+      analysis.in_loop[l] = make_array(function->block_count, sizeof(char));
+      for (int b = 0; b < function->loops[l].block_count; b++) {
+        analysis.in_loop[l][function->loops[l].blocks[b]] = 1;
+      }
+    }
+
+    for (int i = function->begin; i < function->end; i++) {
+      ICInstruction* current = &code->instructions[i];
+      match(current->instruction) {
+        of(ICCheckBounds, index, length) {
+          Range range = range_at(&analysis, *index, i, RANGE_DEPTH);
+          if (range.low >= 0 && range.high < *length) {
+            current->instruction = ICNoop();
+            bounds_checks_removed++;
+          }
+        }
+        otherwise { }
+      }
+    }
+  }
+  remove_noops(code);
+}
\ No newline at end of file
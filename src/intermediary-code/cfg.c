@@ -0,0 +1,373 @@
+#include "cfg.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static void* make_array(int count, size_t size) {
+  void* array = arena_alloc(&intermediary_code_arena, count * size);
+  memset(array, 0, count * size);
+  return array;
+}
+
+static int ends_block(IC* instruction) {
+  return MATCHES(*instruction, ICJump) || MATCHES(*instruction, ICJumpIfFalse) || MATCHES(*instruction, ICReturn);
+}
+
+static void add_edge(FunctionCFG* function, int from, int to) {
+  BasicBlock* block = &function->blocks[from];
+  block->successors[block->successor_count++] = to;
+  function->blocks[to].predecessor_count++;
+}
+
+// `block_of_label` maps labels to the index of the block they start
+static void split_blocks(IntermediaryCode* code, FunctionCFG* function, int* block_of_label) {
+  // First pass counts, the second one fills
+  for (int pass = 0; pass < 2; pass++) {
+    int count = 0;
+    int first = function->begin + 1;
+    for (int i = function->begin + 1; i < function->end; i++) {
+      ICInstruction* current = &code->instructions[i];
+      int starts_block = current->label != NO_STRING && i != first;
+      if (starts_block) {
+        if (pass == 1) {
+          function->blocks[count] = (BasicBlock) { .first = first, .last = i };
+        }
+        count++;
+        first = i;
+      }
+
+      if (current->label != NO_STRING) {
+        block_of_label[current->label] = count;
+      }
+
+      if (ends_block(&current->instruction)) {
+        if (pass == 1) {
+          function->blocks[count] = (BasicBlock) { .first = first, .last = i + 1 };
+        }
+        count++;
+        first = i + 1;
+      }
+    }
+
+    // Whatever is left, and at least one (maybe empty) block so that every function has an entry
+    if (first < function->end || count == 0) {
+      if (pass == 1) {
+        function->blocks[count] = (BasicBlock) { .first = first, .last = function->end };
+      }
+      count++;
+    }
+
+    if (pass == 0) {
+      function->block_count = count;
+      function->blocks = make_array(count, sizeof(BasicBlock));
+    }
+  }
+}
+
+static void connect_blocks(IntermediaryCode* code, FunctionCFG* function, int* block_of_label) {
+  for (int b = 0; b < function->block_count; b++) {
+    BasicBlock* block = &function->blocks[b];
+    int falls_through = b + 1 < function->block_count;
+
+    if (block->last > block->first) {
+      IC* last = &code->instructions[block->last - 1].instruction;
+      match(*last) {
+        of(ICJump, label) {
+          add_edge(function, b, block_of_label[*label]);
+          falls_through = 0;
+        }
+        of(ICJumpIfFalse, _, label) {
+          // Falling through is the true branch, keep it first
+          if (falls_through) {
+            add_edge(function, b, b + 1);
+          }
+          if (!falls_through || block_of_label[*label] != b + 1) {
+            add_edge(function, b, block_of_label[*label]);
+          }
+          falls_through = 0;
+        }
+        of(ICReturn, _) falls_through = 0;
+        otherwise { }
+      }
+    }
+
+    if (falls_through) {
+      add_edge(function, b, b + 1);
+    }
+  }
+
+  for (int b = 0; b < function->block_count; b++) {
+    function->blocks[b].predecessors = make_array(function->blocks[b].predecessor_count, sizeof(int));
+    function->blocks[b].predecessor_count = 0;
+  }
+  for (int b = 0; b < function->block_count; b++) {
+    BasicBlock* block = &function->blocks[b];
+    for (int s = 0; s < block->successor_count; s++) {
+      BasicBlock* successor = &function->blocks[block->successors[s]];
+      successor->predecessors[successor->predecessor_count++] = b;
+    }
+  }
+}
+
+static void number_blocks(FunctionCFG* function) {
+  for (int b = 0; b < function->block_count; b++) {
+    function->blocks[b].postorder = -1;
+    function->blocks[b].immediate_dominator = -1;
+  }
+
+  // Iterative depth-first search, `next_successor` tracks how far each block on the stack got
+  int* stack = make_array(function->block_count, sizeof(int));
+  int* next_successor = make_array(function->block_count, sizeof(int));
+  char* visited = make_array(function->block_count, sizeof(char));
+  int* postorder = make_array(function->block_count, sizeof(int));
+  int depth = 0, count = 0;
+
+  stack[depth++] = 0;
+  visited[0] = 1;
+  while (depth > 0) {
+    int b = stack[depth - 1];
+    BasicBlock* block = &function->blocks[b];
+    if (next_successor[b] < block->successor_count) {
+      int successor = block->successors[next_successor[b]++];
+      if (!visited[successor]) {
+        visited[successor] = 1;
+        stack[depth++] = successor;
+      }
+    } else {
+      block->postorder = count;
+      postorder[count++] = b;
+      depth--;
+    }
+  }
+
+  function->reachable_count = count;
+  function->reverse_postorder = make_array(count, sizeof(int));
+  for (int i = 0; i < count; i++) {
+    function->reverse_postorder[i] = postorder[count - 1 - i];
+  }
+}
+
+static int intersect(FunctionCFG* function, int a, int b) {
+  while (a != b) {
+    while (function->blocks[a].postorder < function->blocks[b].postorder) {
+      a = function->blocks[a].immediate_dominator;
+    }
+    while (function->blocks[b].postorder < function->blocks[a].postorder) {
+      b = function->blocks[b].immediate_dominator;
+    }
+  }
+  return a;
+}
+
+// Cooper, Harvey and Kennedy's "A Simple, Fast Dominance Algorithm"
+static void find_dominators(FunctionCFG* function) {
+  // The entry temporarily dominates itself, so that intersect stops there
+  function->blocks[0].immediate_dominator = 0;
+
+  int changed = 1;
+  while (changed) {
+    changed = 0;
+    for (int i = 1; i < function->reachable_count; i++) {
+      int b = function->reverse_postorder[i];
+      BasicBlock* block = &function->blocks[b];
+
+      int dominator = -1;
+      for (int p = 0; p < block->predecessor_count; p++) {
+        int predecessor = block->predecessors[p];
+        if (function->blocks[predecessor].immediate_dominator == -1) {
+          continue; // Not processed yet, or unreachable
+        }
+        dominator = dominator == -1 ? predecessor : intersect(function, predecessor, dominator);
+      }
+
+      if (block->immediate_dominator != dominator) {
+        block->immediate_dominator = dominator;
+        changed = 1;
+      }
+    }
+  }
+
+  function->blocks[0].immediate_dominator = -1;
+}
+
+int dominates(FunctionCFG* function, int dominator, int block) {
+  if (function->blocks[block].postorder == -1) {
+    return 0;
+  }
+
+  while (block != -1) {
+    if (block == dominator) {
+      return 1;
+    }
+    block = function->blocks[block].immediate_dominator;
+  }
+  return 0;
+}
+
+static void find_loops(FunctionCFG* function) {
+  int count = function->block_count;
+  function->loops = make_array(count, sizeof(Loop));
+  function->loop_count = 0;
+
+  char* in_loop = make_array(count, sizeof(char));
+  int* worklist = make_array(count, sizeof(int));
+
+  // Headers in reverse postorder, so outer loops come before the loops nested in them
+  for (int i = 0; i < function->reachable_count; i++) {
+    int header = function->reverse_postorder[i];
+    BasicBlock* header_block = &function->blocks[header];
+
+    memset(in_loop, 0, count);
+    int size = 0, pending = 0;
+    for (int p = 0; p < header_block->predecessor_count; p++) {
+      int latch = header_block->predecessors[p];
+      if (dominates(function, header, latch) && !in_loop[latch]) {
+        in_loop[latch] = 1;
+        worklist[pending++] = latch;
+        size++;
+      }
+    }
+    if (pending == 0) {
+      continue;
+    }
+
+    // Walk backwards from the back edges, the header stops the walk
+    if (!in_loop[header]) {
+      in_loop[header] = 1;
+      size++;
+    }
+    while (pending > 0) {
+      int b = worklist[--pending];
+      if (b == header) {
+        continue; // Self loop
+      }
+
+      BasicBlock* block = &function->blocks[b];
+      for (int p = 0; p < block->predecessor_count; p++) {
+        int predecessor = block->predecessors[p];
+        if (!in_loop[predecessor] && function->blocks[predecessor].postorder != -1) {
+          in_loop[predecessor] = 1;
+          worklist[pending++] = predecessor;
+          size++;
+        }
+      }
+    }
+
+    Loop* loop = &function->loops[function->loop_count++];
+    *loop = (Loop) { .header = header, .blocks = make_array(size, sizeof(int)), .block_count = 0 };
+    for (int b = 0; b < count; b++) {
+      if (in_loop[b]) {
+        loop->blocks[loop->block_count++] = b;
+        function->blocks[b].loop_depth++;
+      }
+    }
+  }
+}
+
+CFG* make_cfg(IntermediaryCode* code) {
+  CFG* cfg = arena_alloc(&intermediary_code_arena, sizeof(CFG));
+  cfg->function_count = 0;
+  for (int i = 0; i < code->size; i++) {
+    cfg->function_count += MATCHES(code->instructions[i].instruction, ICFunctionBegin);
+  }
+  cfg->functions = make_array(cfg->function_count, sizeof(FunctionCFG));
+
+  // Labels are unique in the whole program, so one map serves every function
+  int* block_of_label = make_array(interned_count(), sizeof(int));
+
+  int f = 0;
+  for (int i = 0; i < code->size; i++) {
+    match(code->instructions[i].instruction) {
+      of(ICFunctionBegin, name) {
+        FunctionCFG* function = &cfg->functions[f++];
+        function->name = *name;
+        function->begin = i;
+        function->end = i + 1;
+        while (!MATCHES(code->instructions[function->end].instruction, ICFunctionEnd)) {
+          function->end++;
+        }
+
+        split_blocks(code, function, block_of_label);
+        connect_blocks(code, function, block_of_label);
+        number_blocks(function);
+        find_dominators(function);
+        find_loops(function);
+      }
+      otherwise { }
+    }
+  }
+
+  return cfg;
+}
+
+// Graphviz strings are double quoted, and \l ends a left-aligned line
+static void print_escaped(FILE* out, const char* text) {
+  for (; *text != '\0'; text++) {
+    if (*text == '"' || *text == '\\') {
+      fputc('\\', out);
+    }
+    fputc(*text, out);
+  }
+}
+
+void print_cfg(FILE* out, IntermediaryCode* code, CFG* cfg) {
+  fprintf(out, "digraph cfg {\n");
+  fprintf(out, "  node [shape=box, fontname=monospace];\n");
+
+  for (int f = 0; f < cfg->function_count; f++) {
+    FunctionCFG* function = &cfg->functions[f];
+    const char* name = string_of(function->name);
+
+    fprintf(out, "  subgraph cluster_%s {\n", name);
+    fprintf(out, "    label=\"%s\";\n", name);
+
+    for (int b = 0; b < function->block_count; b++) {
+      BasicBlock* block = &function->blocks[b];
+      fprintf(out, "    %s_%d [label=\"B%d", name, b, b);
+      if (block->loop_depth > 0) {
+        fprintf(out, " (loop depth %d)", block->loop_depth);
+      }
+      fprintf(out, "\\l");
+
+      for (int i = block->first; i < block->last; i++) {
+        ICInstruction* current = &code->instructions[i];
+        if (current->label != NO_STRING) {
+          fprintf(out, "%s:\\l", string_of(current->label));
+        }
+        if (MATCHES(current->instruction, ICNoop)) {
+          continue;
+        }
+
+        char* text;
+        size_t length;
+        FILE* buffer = open_memstream(&text, &length);
+        print_ic_instruction(buffer, &current->instruction);
+        fclose(buffer);
+
+        fprintf(out, "  ");
+        print_escaped(out, text);
+        fprintf(out, "\\l");
+        free(text);
+      }
+      fprintf(out, "\"%s];\n", block->postorder == -1 ? ", style=dashed" : "");
+
+      for (int s = 0; s < block->successor_count; s++) {
+        const char* edge_label = "";
+        if (block->successor_count == 2) {
+          edge_label = s == 0 ? " [label=true]" : " [label=false]";
+        }
+        fprintf(out, "    %s_%d -> %s_%d%s;\n", name, b, name, block->successors[s], edge_label);
+      }
+      if (block->immediate_dominator != -1) {
+        fprintf(
+            out, "    %s_%d -> %s_%d [style=dotted, color=gray, constraint=false];\n", name, block->immediate_dominator,
+            name, b
+        );
+      }
+    }
+
+    fprintf(out, "  }\n");
+  }
+
+  fprintf(out, "}\n");
+}
\ No newline at end of file
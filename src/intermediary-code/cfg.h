@@ -0,0 +1,61 @@
+#ifndef CFG_H
+#define CFG_H
+
+#include "intermediary-code.h"
+
+#include <stdio.h>
+
+// Straight-line run of instructions, only the first one can be jumped to and only the last one can jump
+typedef struct BasicBlock {
+  int first; // Index of the first instruction in the IntermediaryCode
+  int last;  // One past the last instruction, equal to `first` for empty blocks
+
+  int successors[2];
+  int successor_count;
+  int* predecessors;
+  int predecessor_count;
+
+  int immediate_dominator; // -1 for the entry block and for unreachable blocks
+  int postorder;           // -1 for unreachable blocks
+  int loop_depth;          // How many loops contain this block
+} BasicBlock;
+
+// Natural loop: every block that can reach a back edge into the header without going through the header
+typedef struct Loop {
+  int header;
+  int* blocks; // Header included
+  int block_count;
+} Loop;
+
+// Blocks of one ICFunctionBegin..ICFunctionEnd range. Block 0 is the entry
+typedef struct FunctionCFG {
+  Identifier name;
+  int begin; // Index of the ICFunctionBegin
+  int end;   // Index of the ICFunctionEnd
+
+  BasicBlock* blocks;
+  int block_count;
+
+  // Reachable blocks only
+  int* reverse_postorder;
+  int reachable_count;
+
+  Loop* loops;
+  int loop_count;
+} FunctionCFG;
+
+typedef struct CFG {
+  FunctionCFG* functions;
+  int function_count;
+} CFG;
+
+// Lives in intermediary_code_arena, it must be rebuilt whenever the code changes
+CFG* make_cfg(IntermediaryCode* code);
+
+// Whether every path from the entry to `block` goes through `dominator`
+int dominates(FunctionCFG* function, int dominator, int block);
+
+// Graphviz digraph with a cluster per function
+void print_cfg(FILE* out, IntermediaryCode* code, CFG* cfg);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,280 @@
+#include "optimizations.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int literal_value(Storage storage, int* value) {
+  const char* name = string_of(storage);
+  if (name[0] != '$') {
+    return 0;
+  }
+
+  if (name[1] == '\'') {
+    *value = name[2];
+    return name[3] == '\'' && name[4] == '\0';
+  }
+
+  char* end;
+  long parsed = strtol(name + 1, &end, 10);
+  if (end == name + 1 || *end != '\0' || parsed < INT_MIN || parsed > INT_MAX) {
+    return 0;
+  }
+  *value = parsed;
+  return 1;
+}
+
+Storage make_literal(int value) {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "$%d", value);
+  return intern(buffer);
+}
+
+int evaluate(BinaryOperator operator, int left, int right, int* result) {
+  int value = 0;
+  match(operator) {
+    of(SumOperator) value = (int)((unsigned)left + (unsigned)right);
+    of(SubtractionOperator) value = (int)((unsigned)left - (unsigned)right);
+    of(MultiplicationOperator) value = (int)((unsigned)left * (unsigned)right);
+    of(DivisionOperator) {
+      // Leave the trap to run time
+      if (right == 0 || (left == INT_MIN && right == -1)) {
+        return 0;
+      }
+      value = left / right;
+    }
+    of(LessThanOperator) value = left < right;
+    of(GreaterThanOperator) value = left > right;
+    of(AndOperator) value = left & right;
+    of(OrOperator) value = left | right;
+    of(NotOperator) value = left ^ right;
+    of(LessOrEqualOperator) value = left <= right;
+    of(GreaterOrEqualOperator) value = left >= right;
+    of(EqualsOperator) value = left == right;
+    of(DiffersOperator) value = left != right;
+  }
+
+  *result = value;
+  return 1;
+}
+
+// Storage that always holds the result of `left operator right`, or NO_STRING when it has to be computed
+static Storage simplify(BinaryOperator operator, Storage left, Storage right) {
+  int left_value, right_value, result;
+  int left_known = literal_value(left, &left_value);
+  int right_known = literal_value(right, &right_value);
+
+  if (left_known && right_known) {
+    return evaluate(operator, left_value, right_value, &result) ? make_literal(result) : NO_STRING;
+  }
+
+  Storage simplified = NO_STRING;
+  match(operator) {
+    of(SumOperator) {
+      if (left_known && left_value == 0) {
+        simplified = right;
+      } else if (right_known && right_value == 0) {
+        simplified = left;
+      }
+    }
+    of(SubtractionOperator) {
+      if (right_known && right_value == 0) {
+        simplified = left;
+      } else if (left == right) {
+        simplified = make_literal(0);
+      }
+    }
+    of(MultiplicationOperator) {
+      if ((left_known && left_value == 0) || (right_known && right_value == 0)) {
+        simplified = make_literal(0);
+      } else if (left_known && left_value == 1) {
+        simplified = right;
+      } else if (right_known && right_value == 1) {
+        simplified = left;
+      }
+    }
+    of(DivisionOperator) {
+      if (right_known && right_value == 1) {
+        simplified = left;
+      }
+    }
+    otherwise { }
+  }
+  return simplified;
+}
+
+// Float operations only fold on two literals, none of the identities above hold with NaN, infinities and signed zeros.
+// The arithmetic is done in single precision, like addss and the rest do it
+static Storage simplify_float(BinaryOperator operator, Storage left, Storage right) {
+  float l, r;
+  if (!float_literal_value(left, &l) || !float_literal_value(right, &r)) {
+    return NO_STRING;
+  }
+
+  match(operator) {
+    of(SumOperator) return float_literal(l + r);
+    of(SubtractionOperator) return float_literal(l - r);
+    of(MultiplicationOperator) return float_literal(l * r);
+    of(DivisionOperator) return float_literal(l / r);
+    of(LessThanOperator) return make_literal(l < r);
+    of(GreaterThanOperator) return make_literal(l > r);
+    of(LessOrEqualOperator) return make_literal(l <= r);
+    of(GreaterOrEqualOperator) return make_literal(l >= r);
+    of(EqualsOperator) return make_literal(l == r);
+    of(DiffersOperator) return make_literal(l != r);
+    otherwise return NO_STRING;
+  }
+  return NO_STRING;
+}
+
+// Literal holding `value` converted, or NO_STRING for floats that don't fit in an int
+static Storage convert_literal(Storage value, int to_float) {
+  int integer;
+  float real;
+  if (to_float && literal_value(value, &integer)) {
+    return float_literal((float)integer);
+  }
+  if (!to_float && float_literal_value(value, &real) && real >= -2147483648.0f && real < 2147483648.0f) {
+    return make_literal((int)real);
+  }
+  return NO_STRING;
+}
+
+// Rewrites operands with what is known about them, then folds what became constant
+static void propagate(IntermediaryCode* code) {
+  // Temporaries are written once and never change, so what is known at their definition holds at every use
+  uint32_t count = interned_count();
+  Storage* known = arena_alloc(&intermediary_code_arena, count * sizeof(Storage));
+  memset(known, 0, count * sizeof(Storage));
+
+  for (int i = 0; i < code->size; i++) {
+    IC* instruction = &code->instructions[i].instruction;
+
+    Storage* uses[3];
+    int use_count = ic_uses(instruction, uses);
+    for (int j = 0; j < use_count; j++) {
+      if (*uses[j] < count && known[*uses[j]] != NO_STRING) {
+        *uses[j] = known[*uses[j]];
+      }
+    }
+
+    match(*instruction) {
+      of(ICBinOp, operator, dst, left, right) {
+        Storage simplified = is_float(*left) || is_float(*right) ? simplify_float(*operator, *left, *right)
+                                                                 : simplify(*operator, *left, *right);
+        if (simplified != NO_STRING && is_temporary(*dst)) {
+          if (is_literal(simplified) || is_temporary(simplified)) {
+            known[*dst] = simplified;
+            *instruction = ICNoop();
+          } else {
+            // Variables may change before the temporary is used, so keep a copy of their current value
+            *instruction = ICCopy(*dst, simplified);
+          }
+        }
+      }
+      of(ICConvert, dst, src) {
+        Storage converted = convert_literal(*src, is_float(*dst));
+        if (converted != NO_STRING && is_temporary(*dst)) {
+          known[*dst] = converted;
+          *instruction = ICNoop();
+        } else if (converted != NO_STRING) {
+          *instruction = ICCopy(*dst, converted);
+        }
+      }
+      of(ICJumpIfFalse, condition, label) {
+        int value;
+        if (literal_value(*condition, &value)) {
+          *instruction = value == 0 ? ICJump(*label) : ICNoop();
+        }
+      }
+      of(ICCheckBounds, index, length) {
+        int value;
+        if (literal_value(*index, &value) && value >= 0 && value < *length) {
+          *instruction = ICNoop();
+        }
+      }
+      otherwise { }
+    }
+  }
+}
+
+static int is_noop(ICInstruction* instruction) { return MATCHES(instruction->instruction, ICNoop); }
+
+// Label of the next instruction that does something, or NO_STRING when it has none
+static Label next_label_after(IntermediaryCode* code, int position) {
+  for (int i = position + 1; i < code->size; i++) {
+    if (code->instructions[i].label != NO_STRING || !is_noop(&code->instructions[i])) {
+      return code->instructions[i].label;
+    }
+  }
+  return NO_STRING;
+}
+
+// Drops jumps to the next instruction, labels nobody jumps to and code nothing can reach
+static int remove_dead_branches(IntermediaryCode* code) {
+  int changed = 0;
+
+  uint32_t count = interned_count();
+  char* referenced = arena_alloc(&intermediary_code_arena, count);
+  memset(referenced, 0, count);
+
+  for (int i = 0; i < code->size; i++) {
+    IC* instruction = &code->instructions[i].instruction;
+    match(*instruction) {
+      of(ICJump, label) {
+        if (next_label_after(code, i) == *label) {
+          *instruction = ICNoop();
+          changed = 1;
+        } else {
+          referenced[*label] = 1;
+        }
+      }
+      of(ICJumpIfFalse, _, label) {
+        if (next_label_after(code, i) == *label) {
+          *instruction = ICNoop();
+          changed = 1;
+        } else {
+          referenced[*label] = 1;
+        }
+      }
+      otherwise { }
+    }
+  }
+
+  int reachable = 1;
+  for (int i = 0; i < code->size; i++) {
+    ICInstruction* current = &code->instructions[i];
+
+    if (current->label != NO_STRING && !referenced[current->label]) {
+      current->label = NO_STRING;
+      changed = 1;
+    }
+
+    match(current->instruction) {
+      of(ICFunctionBegin, _) reachable = 1;
+      of(ICFunctionEnd) reachable = 1;
+      otherwise {
+        if (current->label != NO_STRING) {
+          reachable = 1;
+        }
+        if (!reachable && !is_noop(current)) {
+          current->instruction = ICNoop();
+          changed = 1;
+        }
+      }
+    }
+
+    if (MATCHES(current->instruction, ICJump) || MATCHES(current->instruction, ICReturn)) {
+      reachable = 0;
+    }
+  }
+
+  return changed;
+}
+
+void fold_constants(IntermediaryCode* code) {
+  propagate(code);
+  while (remove_dead_branches(code)) { }
+  remove_noops(code);
+}
\ No newline at end of file
@@ -0,0 +1,260 @@
+#include "optimizations.h"
+
+#include <string.h>
+
+int constants_propagated = 0;
+
+// What is known about a value so far. It only ever goes down, from UNKNOWN (no definition seen yet) to CONSTANT and
+// then to VARYING
+typedef enum Level { UNKNOWN, CONSTANT, VARYING } Level;
+
+typedef struct Lattice {
+  Level level;
+  int value; // Only for CONSTANT
+} Lattice;
+
+typedef struct Propagation {
+  Lattice* values; // Indexed by StringId
+  uint32_t size;
+  int changed;
+} Propagation;
+
+static void* make_array(int count, size_t size) {
+  void* array = arena_alloc(&intermediary_code_arena, count * size);
+  memset(array, 0, count * size);
+  return array;
+}
+
+static Lattice value_of(Propagation* propagation, Storage storage) {
+  int value;
+  if (literal_value(storage, &value)) {
+    return (Lattice) { CONSTANT, value };
+  }
+  if (storage < propagation->size && is_local(storage)) {
+    return propagation->values[storage];
+  }
+  return (Lattice) { VARYING, 0 };
+}
+
+static Lattice meet(Lattice a, Lattice b) {
+  if (a.level == UNKNOWN) {
+    return b;
+  }
+  if (b.level == UNKNOWN) {
+    return a;
+  }
+  if (a.level == CONSTANT && b.level == CONSTANT && a.value == b.value) {
+    return a;
+  }
+  return (Lattice) { VARYING, 0 };
+}
+
+static void set_value(Propagation* propagation, Storage storage, Lattice value) {
+  if (storage >= propagation->size || !is_local(storage)) {
+    return;
+  }
+  Lattice* current = &propagation->values[storage];
+  if (current->level != value.level || (value.level == CONSTANT && current->value != value.value)) {
+    *current = value;
+    propagation->changed = 1;
+  }
+}
+
+static Lattice binary_value(Propagation* propagation, BinaryOperator operator, Storage left, Storage right) {
+  Lattice l = value_of(propagation, left);
+  Lattice r = value_of(propagation, right);
+  int result;
+  if (l.level == VARYING || r.level == VARYING) {
+    return (Lattice) { VARYING, 0 };
+  }
+  if (l.level == UNKNOWN || r.level == UNKNOWN) {
+    return (Lattice) { UNKNOWN, 0 };
+  }
+  if (!evaluate(operator, l.value, r.value, &result)) {
+    return (Lattice) { VARYING, 0 };
+  }
+  return (Lattice) { CONSTANT, result };
+}
+
+typedef struct Reachability {
+  char* blocks;
+  char** edges; // Per block, one per predecessor
+} Reachability;
+
+static void mark_edge(Propagation* propagation, Reachability* reachable, FunctionCFG* function, int from, int to) {
+  int position = predecessor_index(&function->blocks[to], from);
+  if (!reachable->edges[to][position]) {
+    reachable->edges[to][position] = 1;
+    reachable->blocks[to] = 1;
+    propagation->changed = 1;
+  }
+}
+
+// Only the edges the condition allows, if it's known
+static void mark_successors(
+    IntermediaryCode* code, Propagation* propagation, Reachability* reachable, FunctionCFG* function, int b
+) {
+  BasicBlock* block = &function->blocks[b];
+  Lattice condition = { VARYING, 0 };
+  if (block->last > block->first) {
+    match(code->instructions[block->last - 1].instruction) {
+      of(ICJumpIfFalse, storage, _) condition = value_of(propagation, *storage);
+      otherwise { }
+    }
+  }
+  if (condition.level == UNKNOWN) {
+    return;
+  }
+
+  int fallthrough = b + 1 < function->block_count ? b + 1 : -1;
+  for (int s = 0; s < block->successor_count; s++) {
+    int successor = block->successors[s];
+    // With a single successor both ways lead there
+    int is_fallthrough = successor == fallthrough;
+    int is_taken = successor != fallthrough || block->successor_count == 1;
+    if (condition.level == VARYING || (condition.value != 0 && is_fallthrough) || (condition.value == 0 && is_taken)) {
+      mark_edge(propagation, reachable, function, b, successor);
+    }
+  }
+}
+
+static void visit_block(
+    IntermediaryCode* code, Propagation* propagation, Reachability* reachable, FunctionCFG* function, FunctionSSA* ssa,
+    int b
+) {
+  BasicBlock* block = &function->blocks[b];
+  for (int p = 0; p < ssa->phi_count[b]; p++) {
+    Phi* phi = &ssa->phis[b][p];
+    Lattice value = { UNKNOWN, 0 };
+    for (int a = 0; a < block->predecessor_count; a++) {
+      if (reachable->edges[b][a]) {
+        value = meet(value, value_of(propagation, phi->arguments[a]));
+      }
+    }
+    set_value(propagation, phi->result, value);
+  }
+
+  for (int i = block->first; i < block->last; i++) {
+    IC* instruction = &code->instructions[i].instruction;
+    match(*instruction) {
+      of(ICCopy, dst, src) set_value(propagation, *dst, value_of(propagation, *src));
+      of(ICBinOp, operator, dst, left, right) {
+        set_value(propagation, *dst, binary_value(propagation, *operator, *left, *right));
+      }
+      otherwise {
+        Storage* definition = ic_definition(instruction);
+        if (definition != NULL) {
+          set_value(propagation, *definition, (Lattice) { VARYING, 0 });
+        }
+      }
+    }
+  }
+
+  mark_successors(code, propagation, reachable, function, b);
+}
+
+static void propagate_in_function(
+    IntermediaryCode* code, Propagation* propagation, FunctionCFG* function, FunctionSSA* ssa
+) {
+  // What the reachable code defines starts out unknown. Anything else, like a variable read before it's ever written,
+  // can hold anything
+  for (int b = 0; b < function->block_count; b++) {
+    if (function->blocks[b].postorder == -1) {
+      continue;
+    }
+    for (int i = function->blocks[b].first; i < function->blocks[b].last; i++) {
+      Storage* definition = ic_definition(&code->instructions[i].instruction);
+      if (definition != NULL && *definition < propagation->size && is_local(*definition)) {
+        propagation->values[*definition] = (Lattice) { UNKNOWN, 0 };
+      }
+    }
+    for (int p = 0; p < ssa->phi_count[b]; p++) {
+      if (ssa->phis[b][p].result != NO_STRING) {
+        propagation->values[ssa->phis[b][p].result] = (Lattice) { UNKNOWN, 0 };
+      }
+    }
+  }
+
+  Reachability reachable = {
+    .blocks = make_array(function->block_count, sizeof(char)),
+    .edges = make_array(function->block_count, sizeof(char*)),
+  };
+  for (int b = 0; b < function->block_count; b++) {
+    reachable.edges[b] = make_array(function->blocks[b].predecessor_count, sizeof(char));
+  }
+  reachable.blocks[0] = 1;
+
+  // Reverse postorder sees most definitions before their uses, so few rounds are needed
+  propagation->changed = 1;
+  while (propagation->changed) {
+    propagation->changed = 0;
+    for (int i = 0; i < function->reachable_count; i++) {
+      int b = function->reverse_postorder[i];
+      if (reachable.blocks[b]) {
+        visit_block(code, propagation, &reachable, function, ssa, b);
+      }
+    }
+  }
+}
+
+static void replace_constant(Propagation* propagation, Storage* storage) {
+  Lattice value = value_of(propagation, *storage);
+  if (value.level == CONSTANT && !is_literal(*storage)) {
+    *storage = make_literal(value.value);
+    constants_propagated++;
+  }
+}
+
+// Uses become literals and constant computations become copies of them, which dead code elimination then drops. Jumps
+// on a constant are left for constant folding
+static void rewrite_function(
+    IntermediaryCode* code, Propagation* propagation, FunctionCFG* function, FunctionSSA* ssa
+) {
+  for (int i = function->begin; i < function->end; i++) {
+    IC* instruction = &code->instructions[i].instruction;
+    Storage* uses[3];
+    int use_count = ic_uses(instruction, uses);
+    for (int u = 0; u < use_count; u++) {
+      replace_constant(propagation, uses[u]);
+    }
+
+    Storage* definition = ic_definition(instruction);
+    if (definition != NULL && MATCHES(*instruction, ICBinOp)) {
+      Lattice value = value_of(propagation, *definition);
+      if (value.level == CONSTANT) {
+        *instruction = ICCopy(*definition, make_literal(value.value));
+      }
+    }
+  }
+
+  for (int b = 0; b < function->block_count; b++) {
+    for (int p = 0; p < ssa->phi_count[b]; p++) {
+      Phi* phi = &ssa->phis[b][p];
+      if (phi->result == NO_STRING) {
+        continue;
+      }
+      Lattice value = value_of(propagation, phi->result);
+      if (value.level == CONSTANT) {
+        // Every use now reads the literal instead
+        phi->result = NO_STRING;
+        continue;
+      }
+      for (int a = 0; a < function->blocks[b].predecessor_count; a++) {
+        replace_constant(propagation, &phi->arguments[a]);
+      }
+    }
+  }
+}
+
+void propagate_constants(IntermediaryCode* code, SSA* ssa) {
+  Propagation propagation = { .size = interned_count() };
+  propagation.values = make_array(propagation.size, sizeof(Lattice));
+  for (uint32_t s = 0; s < propagation.size; s++) {
+    propagation.values[s] = (Lattice) { VARYING, 0 };
+  }
+
+  for (int f = 0; f < ssa->cfg->function_count; f++) {
+    propagate_in_function(code, &propagation, &ssa->cfg->functions[f], &ssa->functions[f]);
+    rewrite_function(code, &propagation, &ssa->cfg->functions[f], &ssa->functions[f]);
+  }
+}
\ No newline at end of file
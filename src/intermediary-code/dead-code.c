@@ -0,0 +1,224 @@
+#include "cfg.h"
+#include "liveness.h"
+#include "optimizations.h"
+
+#include <string.h>
+
+int functions_removed = 0;
+int dead_instructions_removed = 0;
+
+static void* make_array(uint32_t count, size_t size) {
+  void* array = arena_alloc(&intermediary_code_arena, count * size);
+  memset(array, 0, count * size);
+  return array;
+}
+
+static void remove_instruction(ICInstruction* instruction) {
+  if (!MATCHES(instruction->instruction, ICNoop)) {
+    instruction->instruction = ICNoop();
+    dead_instructions_removed++;
+  }
+}
+
+// Call graph walk from main, everything it doesn't reach goes
+static void remove_unreachable_functions(IntermediaryCode* code) {
+  CFG* cfg = make_cfg(code);
+  uint32_t count = interned_count();
+  int* function_of = make_array(count, sizeof(int)); // Index into cfg->functions plus one, 0 when it has no code
+  for (int f = 0; f < cfg->function_count; f++) {
+    function_of[cfg->functions[f].name] = f + 1;
+  }
+
+  char* reached = make_array(cfg->function_count, sizeof(char));
+  int* worklist = make_array(cfg->function_count, sizeof(int));
+  int pending = 0;
+  Identifier entry = intern("main");
+  if (entry < count && function_of[entry] != 0) {
+    reached[function_of[entry] - 1] = 1;
+    worklist[pending++] = function_of[entry] - 1;
+  }
+
+  while (pending > 0) {
+    FunctionCFG* function = &cfg->functions[worklist[--pending]];
+    for (int i = function->begin; i < function->end; i++) {
+      match(code->instructions[i].instruction) {
+        of(ICCall, name, _) {
+          int callee = *name < count ? function_of[*name] - 1 : -1;
+          if (callee != -1 && !reached[callee]) {
+            reached[callee] = 1;
+            worklist[pending++] = callee;
+          }
+        }
+        otherwise { }
+      }
+    }
+  }
+
+  int size = 0;
+  for (int f = 0, i = 0; i < code->size; i++) {
+    if (f < cfg->function_count && i == cfg->functions[f].begin && !reached[f]) {
+      i = cfg->functions[f++].end;
+      functions_removed++;
+      continue;
+    }
+    if (f < cfg->function_count && i == cfg->functions[f].end) {
+      f++;
+    }
+    code->instructions[size++] = code->instructions[i];
+  }
+  code->size = size;
+}
+
+// Blocks no path from the entry reaches. Only unreachable jumps can target their labels, so those go too
+static void remove_unreachable_blocks(IntermediaryCode* code) {
+  CFG* cfg = make_cfg(code);
+  for (int f = 0; f < cfg->function_count; f++) {
+    FunctionCFG* function = &cfg->functions[f];
+    for (int b = 0; b < function->block_count; b++) {
+      BasicBlock* block = &function->blocks[b];
+      if (block->postorder != -1) {
+        continue;
+      }
+      for (int i = block->first; i < block->last; i++) {
+        code->instructions[i].label = NO_STRING;
+        remove_instruction(&code->instructions[i]);
+      }
+    }
+  }
+  remove_noops(code);
+}
+
+// Computing a value has no effect besides its result, unlike calls, input and parameters
+static int is_pure(IC* instruction) {
+  return MATCHES(*instruction, ICCopy) || MATCHES(*instruction, ICBinOp) || MATCHES(*instruction, ICCopyFrom) ||
+         MATCHES(*instruction, ICConvert);
+}
+
+// Nothing ever reads these globals, so writing to them is pointless
+static void remove_unread_globals(IntermediaryCode* code) {
+  uint32_t count = interned_count();
+  char* read = make_array(count, sizeof(char));
+  for (int i = 0; i < code->size; i++) {
+    IC* instruction = &code->instructions[i].instruction;
+    Storage* uses[3];
+    int use_count = ic_uses(instruction, uses);
+    for (int u = 0; u < use_count; u++) {
+      read[*uses[u]] = 1;
+    }
+    match(*instruction) {
+      of(ICCopyFrom, _, array, _) read[*array] = 1;
+      otherwise { }
+    }
+  }
+
+  for (int i = 0; i < code->size; i++) {
+    IC* instruction = &code->instructions[i].instruction;
+    Storage* definition = ic_definition(instruction);
+    if (definition != NULL && is_pure(instruction) && !is_local(*definition) && !read[*definition]) {
+      remove_instruction(&code->instructions[i]);
+    }
+    match(*instruction) {
+      of(ICCopyAt, array, _, _) {
+        if (!read[*array]) {
+          remove_instruction(&code->instructions[i]);
+        }
+      }
+      otherwise { }
+    }
+  }
+  remove_noops(code);
+}
+
+// Stores to locals nobody reads afterwards. Removing one can make the values it read dead as well, so it goes until
+// nothing changes
+static void remove_dead_stores(IntermediaryCode* code) {
+  int changed = 1;
+  while (changed) {
+    changed = 0;
+    CFG* cfg = make_cfg(code);
+    Liveness* liveness = analyze_liveness(code, cfg);
+
+    for (int f = 0; f < cfg->function_count; f++) {
+      FunctionCFG* function = &cfg->functions[f];
+      FunctionLiveness* live = &liveness->functions[f];
+      int words = SET_WORDS(live->temporary_count);
+      TemporarySet set = make_array(words, sizeof(uint64_t));
+
+      for (int b = 0; b < function->block_count; b++) {
+        memcpy(set, live->live_out[b], words * sizeof(uint64_t));
+
+        for (int i = function->blocks[b].last - 1; i >= function->blocks[b].first; i--) {
+          IC* instruction = &code->instructions[i].instruction;
+          Storage* definition = ic_definition(instruction);
+          int index = definition == NULL ? -1 : temporary_index(liveness, *definition);
+          if (index != -1 && !SET_CONTAINS(set, index) && is_pure(instruction)) {
+            remove_instruction(&code->instructions[i]);
+            changed = 1;
+            continue;
+          }
+
+          if (index != -1) {
+            SET_REMOVE(set, index);
+          }
+          Storage* uses[3];
+          int use_count = ic_uses(instruction, uses);
+          for (int u = 0; u < use_count; u++) {
+            int used = temporary_index(liveness, *uses[u]);
+            if (used != -1) {
+              SET_INSERT(set, used);
+            }
+          }
+        }
+      }
+    }
+
+    remove_noops(code);
+  }
+}
+
+// Global variables and arrays the code no longer mentions
+static void remove_unused_declarations(IntermediaryCode* code, Program* program) {
+  uint32_t count = interned_count();
+  char* mentioned = make_array(count, sizeof(char));
+  for (int i = 0; i < code->size; i++) {
+    IC* instruction = &code->instructions[i].instruction;
+    Storage* uses[3];
+    int use_count = ic_uses(instruction, uses);
+    for (int u = 0; u < use_count; u++) {
+      mentioned[*uses[u]] = 1;
+    }
+    Storage* definition = ic_definition(instruction);
+    if (definition != NULL) {
+      mentioned[*definition] = 1;
+    }
+    match(*instruction) {
+      of(ICCopyAt, array, _, _) mentioned[*array] = 1;
+      of(ICCopyFrom, _, array, _) mentioned[*array] = 1;
+      otherwise { }
+    }
+  }
+
+  DeclarationList** link = &program->declarations;
+  while (*link != NULL) {
+    Identifier name = NO_STRING;
+    match((*link)->declaration) {
+      of(VariableDeclaration, _, identifier, _) name = *identifier;
+      of(ArrayDeclaration, _, identifier, _, _) name = *identifier;
+      otherwise { }
+    }
+
+    if (name != NO_STRING && !mentioned[name]) {
+      *link = (*link)->next;
+    } else {
+      link = &(*link)->next;
+    }
+  }
+}
+
+void eliminate_dead_code(IntermediaryCode* code, Program* program) {
+  remove_unreachable_functions(code);
+  remove_unreachable_blocks(code);
+  remove_unread_globals(code);
+  remove_dead_stores(code);
+  remove_unused_declarations(code, program);
+}
\ No newline at end of file
@@ -0,0 +1,244 @@
+#include "optimizations.h"
+
+#include <string.h>
+
+int globals_promoted = 0;
+
+typedef struct Function {
+  int begin;         // Index of the ICFunctionBegin
+  int end;           // Index of the ICFunctionEnd
+  char* accessed;    // Per global: read or written by the function itself
+  char* written;     // Per global
+  char* reached;     // Per global: accessed by the function or anything it calls
+  int calls_unknown; // Calls a function without an implementation, which could do anything
+} Function;
+
+typedef struct Globals {
+  int* index_of; // Indexed by StringId: position in `storages` plus one, 0 for anything else
+  uint32_t size;
+  Storage* storages;
+  int count;
+} Globals;
+
+static void* make_array(int count, size_t size) {
+  void* array = arena_alloc(&intermediary_code_arena, count * size);
+  memset(array, 0, count * size);
+  return array;
+}
+
+// Scalar globals, arrays never show up as uses or definitions
+static int global_index(Globals* globals, char* is_string, Storage storage) {
+  if (is_local(storage) || is_literal(storage) || is_string[storage]) {
+    return -1;
+  }
+  if (globals->index_of[storage] == 0) {
+    globals->storages[globals->count++] = storage;
+    globals->index_of[storage] = globals->count;
+  }
+  return globals->index_of[storage] - 1;
+}
+
+// Marks what the function accesses when `function` isn't NULL, otherwise only numbers the globals
+static void find_accesses(
+    IntermediaryCode* code, int begin, int end, Function* function, Globals* globals, char* is_string
+) {
+  for (int i = begin; i < end; i++) {
+    IC* instruction = &code->instructions[i].instruction;
+    Storage* uses[3];
+    int use_count = ic_uses(instruction, uses);
+    for (int u = 0; u < use_count; u++) {
+      int index = global_index(globals, is_string, *uses[u]);
+      if (index != -1 && function != NULL) {
+        function->accessed[index] = 1;
+      }
+    }
+    Storage* definition = ic_definition(instruction);
+    int index = definition == NULL ? -1 : global_index(globals, is_string, *definition);
+    if (index != -1 && function != NULL) {
+      function->accessed[index] = 1;
+      function->written[index] = 1;
+    }
+  }
+}
+
+// Everything each function can reach through its calls, until nothing changes
+static void find_reached(
+    IntermediaryCode* code, Function* functions, int function_count, int* function_of, int globals
+) {
+  for (int f = 0; f < function_count; f++) {
+    memset(functions[f].reached, functions[f].calls_unknown, globals);
+    for (int g = 0; g < globals; g++) {
+      functions[f].reached[g] |= functions[f].accessed[g];
+    }
+  }
+
+  int changed = 1;
+  while (changed) {
+    changed = 0;
+    for (int f = 0; f < function_count; f++) {
+      for (int i = functions[f].begin; i < functions[f].end; i++) {
+        match(code->instructions[i].instruction) {
+          of(ICCall, name, _) {
+            int callee = function_of[*name] - 1;
+            for (int g = 0; g < globals && callee != -1; g++) {
+              if (functions[callee].reached[g] && !functions[f].reached[g]) {
+                functions[f].reached[g] = 1;
+                changed = 1;
+              }
+            }
+          }
+          otherwise { }
+        }
+      }
+    }
+  }
+}
+
+// Writes the promoted globals back, right before `instruction` leaves the function
+static void append_stores(
+    IntermediaryCode* result, ICInstruction* instruction, Function* function, Globals* globals, Storage* local_of
+) {
+  Label label = instruction->label;
+  for (int g = 0; g < globals->count; g++) {
+    if (local_of[g] != NO_STRING && function->written[g]) {
+      append_ic(result, ICCopy(globals->storages[g], local_of[g]));
+      result->instructions[result->size - 1].label = label;
+      label = NO_STRING;
+    }
+  }
+  append_ic(result, instruction->instruction);
+  result->instructions[result->size - 1].label = label;
+}
+
+static Storage promoted(Globals* globals, Storage* local_of, Storage storage) {
+  int index = storage < globals->size ? globals->index_of[storage] : 0;
+  return index != 0 && local_of[index - 1] != NO_STRING ? local_of[index - 1] : storage;
+}
+
+static void promote_in_function(
+    IntermediaryCode* code, IntermediaryCode* result, Function* function, Function* functions, int* function_of,
+    Globals* globals
+) {
+  // Whatever a callee can reach has to be in memory during the call
+  char* clobbered = make_array(globals->count, sizeof(char));
+  memset(clobbered, function->calls_unknown, globals->count);
+  for (int i = function->begin; i < function->end; i++) {
+    match(code->instructions[i].instruction) {
+      of(ICCall, name, _) {
+        int callee = function_of[*name] - 1;
+        for (int g = 0; g < globals->count && callee != -1; g++) {
+          clobbered[g] |= functions[callee].reached[g];
+        }
+      }
+      otherwise { }
+    }
+  }
+
+  Identifier name = NO_STRING;
+  match(code->instructions[function->begin].instruction) {
+    of(ICFunctionBegin, identifier) name = *identifier;
+    otherwise { }
+  }
+  Storage* local_of = make_array(globals->count, sizeof(Storage));
+  for (int g = 0; g < globals->count; g++) {
+    local_of[g] = NO_STRING;
+    if (function->accessed[g] && !clobbered[g]) {
+      local_of[g] = copy_of_local(local_variable(name, string_of(globals->storages[g])));
+      if (is_float(globals->storages[g])) {
+        mark_float(local_of[g]);
+      }
+      globals_promoted++;
+    }
+  }
+
+  int body = function->begin + 1;
+  while (MATCHES(code->instructions[body].instruction, ICParameter)) {
+    body++;
+  }
+  for (int i = function->begin; i < body; i++) {
+    append_ic(result, code->instructions[i].instruction);
+    result->instructions[result->size - 1].label = code->instructions[i].label;
+  }
+  for (int g = 0; g < globals->count; g++) {
+    if (local_of[g] != NO_STRING) {
+      append_ic(result, ICCopy(local_of[g], globals->storages[g]));
+    }
+  }
+
+  for (int i = body; i <= function->end; i++) {
+    ICInstruction current = code->instructions[i];
+    IC* instruction = &current.instruction;
+    Storage* uses[3];
+    int use_count = ic_uses(instruction, uses);
+    for (int u = 0; u < use_count; u++) {
+      *uses[u] = promoted(globals, local_of, *uses[u]);
+    }
+    Storage* definition = ic_definition(instruction);
+    if (definition != NULL) {
+      *definition = promoted(globals, local_of, *definition);
+    }
+
+    if (MATCHES(*instruction, ICReturn) || MATCHES(*instruction, ICFunctionEnd)) {
+      append_stores(result, &current, function, globals, local_of);
+    } else {
+      append_ic(result, *instruction);
+      result->instructions[result->size - 1].label = current.label;
+    }
+  }
+}
+
+void promote_globals(IntermediaryCode* code) {
+  uint32_t count = interned_count();
+  char* is_string = make_array(count, sizeof(char));
+  for (StringDeclarationList* constant = string_constants; constant != NULL; constant = constant->next) {
+    is_string[constant->identifier] = 1;
+  }
+
+  int function_count = 0;
+  for (int i = 0; i < code->size; i++) {
+    function_count += MATCHES(code->instructions[i].instruction, ICFunctionBegin);
+  }
+  Function* functions = make_array(function_count, sizeof(Function));
+  int* function_of = make_array(count, sizeof(int)); // Index into `functions` plus one, 0 when it has no code
+  for (int f = 0, i = 0; i < code->size; i++) {
+    match(code->instructions[i].instruction) {
+      of(ICFunctionBegin, name) {
+        function_of[*name] = f + 1;
+        functions[f].begin = i;
+      }
+      of(ICFunctionEnd) functions[f++].end = i;
+      otherwise { }
+    }
+  }
+
+  // At most one global per interned string
+  Globals globals = {
+    .index_of = make_array(count, sizeof(int)),
+    .size = count,
+    .storages = make_array(count, sizeof(Storage)),
+    .count = 0,
+  };
+  find_accesses(code, 0, code->size, NULL, &globals, is_string);
+  for (int f = 0; f < function_count; f++) {
+    functions[f].accessed = make_array(globals.count, sizeof(char));
+    functions[f].written = make_array(globals.count, sizeof(char));
+    find_accesses(code, functions[f].begin, functions[f].end, &functions[f], &globals, is_string);
+  }
+  for (int f = 0; f < function_count; f++) {
+    functions[f].reached = make_array(globals.count, sizeof(char));
+    for (int i = functions[f].begin; i < functions[f].end; i++) {
+      match(code->instructions[i].instruction) {
+        of(ICCall, name, _) functions[f].calls_unknown |= function_of[*name] == 0;
+        otherwise { }
+      }
+    }
+  }
+  find_reached(code, functions, function_count, function_of, globals.count);
+
+  IntermediaryCode* result = arena_alloc(&intermediary_code_arena, sizeof(IntermediaryCode));
+  *result = (IntermediaryCode) { .instructions = NULL, .size = 0, .capacity = 0 };
+  for (int f = 0; f < function_count; f++) {
+    promote_in_function(code, result, &functions[f], functions, function_of, &globals);
+  }
+  *code = *result;
+}
\ No newline at end of file
@@ -0,0 +1,264 @@
+#include "optimizations.h"
+
+#include <string.h>
+
+int calls_inlined = 0;
+
+typedef struct Function {
+  int begin; // Index of the ICFunctionBegin, -1 for functions without an implementation
+  int end;   // Index of the ICFunctionEnd
+  int parameter_count;
+  int size;       // Instructions that do something, parameters left out
+  int returns;    // How many ICReturn there are
+  int recursive;  // Calls itself directly
+  int call_sites; // Before inlining
+} Function;
+
+// Fresh names for the locals and labels of the function being inlined, valid while `round` matches the current one
+typedef struct Renaming {
+  StringId* renamed;
+  int* round;
+  int current_round;
+  uint32_t size;
+} Renaming;
+
+static StringId rename_local(Renaming* renaming, StringId name) {
+  if (name >= renaming->size || !is_local(name)) {
+    return name;
+  }
+  if (renaming->round[name] != renaming->current_round) {
+    renaming->renamed[name] = copy_of_local(name);
+    renaming->round[name] = renaming->current_round;
+  }
+  return renaming->renamed[name];
+}
+
+static Label rename_label(Renaming* renaming, Label label) {
+  if (renaming->round[label] != renaming->current_round) {
+    renaming->renamed[label] = next_label();
+    renaming->round[label] = renaming->current_round;
+  }
+  return renaming->renamed[label];
+}
+
+static Function* find_functions(IntermediaryCode* code) {
+  uint32_t count = interned_count();
+  Function* functions = arena_alloc(&intermediary_code_arena, count * sizeof(Function));
+  for (uint32_t i = 0; i < count; i++) {
+    functions[i] = (Function) { .begin = -1 };
+  }
+
+  Function* current = NULL;
+  Identifier current_name = NO_STRING;
+  for (int i = 0; i < code->size; i++) {
+    ICInstruction* instruction = &code->instructions[i];
+    match(instruction->instruction) {
+      of(ICFunctionBegin, name) {
+        current = &functions[*name];
+        current_name = *name;
+        current->begin = i;
+      }
+      of(ICFunctionEnd) current->end = i;
+      of(ICParameter, _) current->parameter_count++;
+      of(ICNoop) { }
+      of(ICCall, name, _) {
+        functions[*name].call_sites++;
+        current->recursive = current->recursive || *name == current_name;
+        current->size++;
+      }
+      of(ICReturn, _) {
+        current->returns++;
+        current->size++;
+      }
+      otherwise current->size++;
+    }
+  }
+
+  return functions;
+}
+
+// NULL when the call should be inlined, otherwise the reason not to
+static const char* reason_to_keep(Function* callee, Identifier caller, Identifier name, int arguments, int limit) {
+  if (callee->begin == -1) {
+    return "no implementation";
+  }
+  if (callee->recursive || caller == name) {
+    return "recursive";
+  }
+  if (callee->parameter_count != arguments) {
+    return "wrong number of arguments";
+  }
+  // A function called once doesn't get any bigger by being inlined, so those get more room
+  int budget = callee->call_sites == 1 ? 4 * limit : limit;
+  if (callee->size > budget) {
+    return "too large";
+  }
+  return NULL;
+}
+
+// Parameters become copies of the arguments, and returns become a copy into `dst` plus a jump past the body
+static void inline_call(
+    IntermediaryCode* code, IntermediaryCode* result, Identifier name, Function* callee, Storage* arguments, Storage dst,
+    Renaming* renaming
+) {
+  renaming->current_round++;
+  Label end = next_label();
+  // With several returns `dst` would be written more than once, and temporaries can't be
+  Storage returned = callee->returns > 1 ? copy_of_local(local_variable(name, "return")) : dst;
+  if (is_float(dst)) {
+    mark_float(returned);
+  }
+
+  for (int p = 0; p < callee->parameter_count; p++) {
+    Storage* parameter = ic_definition(&code->instructions[callee->begin + 1 + p].instruction);
+    append_ic(result, ICCopy(rename_local(renaming, *parameter), arguments[p]));
+  }
+
+  for (int i = callee->begin + 1 + callee->parameter_count; i < callee->end; i++) {
+    ICInstruction current = code->instructions[i];
+    IC* instruction = &current.instruction;
+
+    Storage* uses[3];
+    int use_count = ic_uses(instruction, uses);
+    for (int u = 0; u < use_count; u++) {
+      *uses[u] = rename_local(renaming, *uses[u]);
+    }
+    Storage* definition = ic_definition(instruction);
+    if (definition != NULL) {
+      *definition = rename_local(renaming, *definition);
+    }
+
+    match(*instruction) {
+      of(ICJump, label) *label = rename_label(renaming, *label);
+      of(ICJumpIfFalse, _, label) *label = rename_label(renaming, *label);
+      otherwise { }
+    }
+    if (current.label != NO_STRING) {
+      append_label(result, rename_label(renaming, current.label));
+    }
+
+    match(*instruction) {
+      of(ICReturn, src) {
+        append_ic(result, ICCopy(returned, *src));
+        append_ic(result, ICJump(end));
+      }
+      otherwise append_ic(result, *instruction);
+    }
+  }
+
+  append_label(result, end);
+  if (returned != dst) {
+    append_ic(result, ICCopy(dst, returned));
+  }
+}
+
+// Functions whose every call got inlined are dropped, nothing can reach them anymore
+static void remove_unused_functions(IntermediaryCode* code, Function* functions) {
+  uint32_t count = interned_count();
+  int* calls = arena_alloc(&intermediary_code_arena, count * sizeof(int));
+  memset(calls, 0, count * sizeof(int));
+  for (int i = 0; i < code->size; i++) {
+    match(code->instructions[i].instruction) {
+      of(ICCall, name, _) calls[*name]++;
+      otherwise { }
+    }
+  }
+
+  int size = 0;
+  int keep = 1;
+  for (int i = 0; i < code->size; i++) {
+    match(code->instructions[i].instruction) {
+      of(ICFunctionBegin, name) keep = calls[*name] > 0 || functions[*name].call_sites == 0;
+      otherwise { }
+    }
+    if (keep) {
+      code->instructions[size++] = code->instructions[i];
+    }
+  }
+  code->size = size;
+}
+
+void inline_functions(IntermediaryCode* code, int limit, FILE* report) {
+  Function* functions = find_functions(code);
+
+  uint32_t names = interned_count();
+  Renaming renaming = {
+    .renamed = arena_alloc(&intermediary_code_arena, names * sizeof(StringId)),
+    .round = arena_alloc(&intermediary_code_arena, names * sizeof(int)),
+    .current_round = 0,
+    .size = names,
+  };
+  memset(renaming.round, 0, names * sizeof(int));
+
+  IntermediaryCode* result = arena_alloc(&intermediary_code_arena, sizeof(IntermediaryCode));
+  *result = (IntermediaryCode) { .instructions = NULL, .size = 0, .capacity = 0 };
+
+  Identifier caller = NO_STRING;
+  for (int i = 0; i < code->size; i++) {
+    ICInstruction* current = &code->instructions[i];
+    int is_call = 0;
+    match(current->instruction) {
+      of(ICFunctionBegin, name) caller = *name;
+      of(ICArgument, _) is_call = 1;
+      of(ICCall, _, _) is_call = 1;
+      otherwise { }
+    }
+
+    if (!is_call) {
+      append_ic(result, current->instruction);
+      result->instructions[result->size - 1].label = current->label;
+      continue;
+    }
+
+    // The arguments of a call come right before it
+    int call = i;
+    while (MATCHES(code->instructions[call].instruction, ICArgument)) {
+      call++;
+    }
+    Identifier name = NO_STRING;
+    Storage dst = NO_STRING;
+    match(code->instructions[call].instruction) {
+      of(ICCall, callee, destination) {
+        name = *callee;
+        dst = *destination;
+      }
+      otherwise { }
+    }
+
+    Storage arguments[call - i + 1];
+    for (int a = i; a < call; a++) {
+      match(code->instructions[a].instruction) {
+        of(ICArgument, src) arguments[a - i] = *src;
+        otherwise { }
+      }
+    }
+
+    const char* reason = reason_to_keep(&functions[name], caller, name, call - i, limit);
+    if (report != NULL) {
+      if (reason == NULL) {
+        fprintf(
+            report, "inlined %s into %s (%d instructions)\n", string_of(name), string_of(caller), functions[name].size
+        );
+      } else {
+        fprintf(report, "kept call to %s in %s: %s\n", string_of(name), string_of(caller), reason);
+      }
+    }
+
+    if (reason == NULL) {
+      if (current->label != NO_STRING) {
+        append_label(result, current->label);
+      }
+      inline_call(code, result, name, &functions[name], arguments, dst, &renaming);
+      calls_inlined++;
+    } else {
+      for (int a = i; a <= call; a++) {
+        append_ic(result, code->instructions[a].instruction);
+        result->instructions[result->size - 1].label = code->instructions[a].label;
+      }
+    }
+    i = call;
+  }
+
+  remove_unused_functions(result, functions);
+  *code = *result;
+}
\ No newline at end of file
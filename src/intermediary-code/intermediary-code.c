@@ -1,12 +1,16 @@
 #include "intermediary-code.h"
 
-#include "semantic-check.h"
+#include "symbol-table.h"
 #include "syntax-tree.h"
 
 #include <stdlib.h>
 #include <string.h>
 
+Arena intermediary_code_arena = { .name = "intermediary code" };
+
 StringDeclarationList* string_constants = NULL;
+int string_constant_count = 0;
+int temporary_count = 0;
 
 Label next_label() {
   static int current_label = 0;
@@ -15,71 +19,247 @@ Label next_label() {
   snprintf(buffer, sizeof(buffer), "label_%d", current_label);
   current_label++;
 
-  return strdup(buffer);
+  return intern(buffer);
 }
 
-Storage next_storage() {
-  static int current_storage = 0;
+#define TEMPORARY 1
+#define VARIABLE 2
+
+// Flags indexed by StringId, set for the temporaries and local variables
+static char* locals = NULL;
+static uint32_t locals_capacity = 0;
+
+// Flags indexed by StringId, set for whatever holds a float
+static char* floats = NULL;
+static uint32_t floats_capacity = 0;
+
+static void set_flag(char** flags, uint32_t* flags_capacity, Storage storage, char value) {
+  if (storage >= *flags_capacity) {
+    uint32_t capacity = *flags_capacity == 0 ? 1024 : *flags_capacity;
+    while (capacity <= storage) {
+      capacity *= 2;
+    }
+    *flags = arena_realloc(&intermediary_code_arena, *flags, *flags_capacity, capacity);
+    memset(*flags + *flags_capacity, 0, capacity - *flags_capacity);
+    *flags_capacity = capacity;
+  }
+  (*flags)[storage] = value;
+}
 
+static void mark_local(Storage storage, char kind) { set_flag(&locals, &locals_capacity, storage, kind); }
+
+void mark_float(Storage storage) { set_flag(&floats, &floats_capacity, storage, 1); }
+
+int is_float(Storage storage) { return storage < floats_capacity && floats[storage]; }
+
+Storage next_storage() {
   char buffer[256];
-  snprintf(buffer, sizeof(buffer), "storage_%d", current_storage);
-  current_storage++;
+  snprintf(buffer, sizeof(buffer), "storage_%d", temporary_count);
+  temporary_count++;
 
-  return strdup(buffer);
+  Storage storage = intern(buffer);
+  mark_local(storage, TEMPORARY);
+  return storage;
 }
 
-IntermediaryCode* make_ic(IC instruction) {
-  IntermediaryCode* ic = malloc(sizeof(IntermediaryCode));
-  ic->next = NULL;
-  ic->instruction = instruction;
-  ic->label = NULL;
-  return ic;
+// Parameters of the function being generated
+static Identifier current_function = NO_STRING;
+static ParametersDeclaration* current_parameters = NULL;
+
+Storage local_variable(Identifier function, const char* name) {
+  char buffer[512];
+  snprintf(buffer, sizeof(buffer), "%s.%s", string_of(function), name);
+
+  Storage storage = intern(buffer);
+  mark_local(storage, VARIABLE);
+  return storage;
 }
 
-IntermediaryCode* concat_ic(IntermediaryCode* first, IntermediaryCode* second) {
-  if (first == NULL) {
-    return second;
+Storage copy_of_local(Storage local) {
+  Storage storage;
+  if (is_temporary(local)) {
+    storage = next_storage();
+  } else {
+    static int copies = 0;
+    char buffer[512];
+    snprintf(buffer, sizeof(buffer), "%s.%d", string_of(local), copies++);
+
+    storage = intern(buffer);
+    mark_local(storage, VARIABLE);
   }
-  if (second == NULL) {
-    return first;
+
+  if (is_float(local)) {
+    mark_float(storage);
   }
+  return storage;
+}
 
-  if (first->next == NULL) {
-    first->next = second;
-    return first;
+Storage float_literal(float value) {
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "$%.9g", value);
+  // Infinities and NaN are spelled out, they have an n
+  if (strpbrk(buffer, ".en") == NULL) {
+    strcat(buffer, ".0");
   }
 
-  first->next = concat_ic(first->next, second);
-  return first;
+  Storage storage = intern(buffer);
+  mark_float(storage);
+  return storage;
 }
 
-IntermediaryCode* with_label(IntermediaryCode* ic, Label label) {
-  if (ic->label != NULL) {
-    IntermediaryCode* noop = make_ic(ICNoop());
-    noop->label = label;
-    return concat_ic(noop, ic);
+int float_literal_value(Storage storage, float* value) {
+  if (!is_float(storage) || !is_literal(storage)) {
+    return 0;
   }
+  *value = strtof(string_of(storage) + 1, NULL);
+  return 1;
+}
 
-  ic->label = label;
-  return ic;
+// Parameters shadow the globals, everything else is named after its identifier
+static Storage variable_storage(Identifier identifier) {
+  for (ParametersDeclaration* parameter = current_parameters; parameter != NULL; parameter = parameter->next) {
+    if (parameter->name == identifier) {
+      return local_variable(current_function, string_of(identifier));
+    }
+  }
+  return identifier;
 }
 
-StatementList* from_statement(Statement statement) {
-  match(statement) {
-    of(BlockStatement, list) { return *list; }
-    otherwise {
-      StatementList* list = malloc(sizeof(StatementList));
-      list->next = NULL;
-      list->statement = statement;
-      return list;
+Storage next_string_constant() {
+  char buffer[256];
+  snprintf(buffer, sizeof(buffer), "string_%d", string_constant_count);
+  string_constant_count++;
+
+  return intern(buffer);
+}
+
+// Indexed by the interned text of a literal: the constant holding it, NO_STRING when there's none yet
+static Storage* constant_of_text = NULL;
+static uint32_t constant_capacity = 0;
+static StringDeclarationList* last_string_constant = NULL;
+
+Storage string_constant(char* value) {
+  StringId text = intern(value);
+  if (text >= constant_capacity) {
+    uint32_t capacity = constant_capacity == 0 ? 1024 : constant_capacity;
+    while (capacity <= text) {
+      capacity *= 2;
     }
+    constant_of_text = arena_realloc(
+        &intermediary_code_arena, constant_of_text, constant_capacity * sizeof(Storage), capacity * sizeof(Storage)
+    );
+    memset(constant_of_text + constant_capacity, 0, (capacity - constant_capacity) * sizeof(Storage));
+    constant_capacity = capacity;
+  }
+  if (constant_of_text[text] != NO_STRING) {
+    return constant_of_text[text];
+  }
+
+  StringDeclarationList* declaration = arena_alloc(&intermediary_code_arena, sizeof(StringDeclarationList));
+  *declaration = (StringDeclarationList) { .identifier = next_string_constant(), .value = value, .next = NULL };
+  if (string_constants == NULL) {
+    string_constants = declaration;
+  } else {
+    last_string_constant->next = declaration;
   }
+  last_string_constant = declaration;
+
+  constant_of_text[text] = declaration->identifier;
+  return declaration->identifier;
+}
+
+int is_temporary(Storage storage) { return storage < locals_capacity && locals[storage] == TEMPORARY; }
 
-  // Not supposed to happen
+int is_local_variable(Storage storage) { return storage < locals_capacity && locals[storage] == VARIABLE; }
+
+int is_local(Storage storage) { return storage < locals_capacity && locals[storage] != 0; }
+
+int is_literal(Storage storage) { return string_of(storage)[0] == '$'; }
+
+int ic_uses(IC* instruction, Storage* uses[3]) {
+  int count = 0;
+  match(*instruction) {
+    of(ICJumpIfFalse, condition, _) uses[count++] = condition;
+    of(ICCopy, _, src) uses[count++] = src;
+    of(ICCopyAt, _, index, src) {
+      uses[count++] = index;
+      uses[count++] = src;
+    }
+    of(ICCopyFrom, _, _, index) uses[count++] = index;
+    of(ICBinOp, _, _, left, right) {
+      uses[count++] = left;
+      uses[count++] = right;
+    }
+    of(ICPrint, src) uses[count++] = src;
+    of(ICReturn, src) uses[count++] = src;
+    of(ICArgument, src) uses[count++] = src;
+    of(ICCheckBounds, index, _) uses[count++] = index;
+    of(ICConvert, _, src) uses[count++] = src;
+    otherwise { }
+  }
+  return count;
+}
+
+Storage* ic_definition(IC* instruction) {
+  match(*instruction) {
+    of(ICCopy, dst, _) return dst;
+    of(ICCopyFrom, dst, _, _) return dst;
+    of(ICCall, _, dst) return dst;
+    of(ICInput, _, dst) return dst;
+    of(ICBinOp, _, dst, _, _) return dst;
+    of(ICParameter, dst) return dst;
+    of(ICConvert, dst, _) return dst;
+    otherwise return NULL;
+  }
   return NULL;
 }
 
-IntermediaryCode* make_intermediary_code_expression(Expression expr, Storage* result, DeclarationList* declarations) {
+void append_ic(IntermediaryCode* code, IC instruction) {
+  if (code->size == code->capacity) {
+    int capacity = code->capacity == 0 ? 1024 : code->capacity * 2;
+    code->instructions = arena_realloc(
+        &intermediary_code_arena, code->instructions, code->capacity * sizeof(ICInstruction),
+        capacity * sizeof(ICInstruction)
+    );
+    code->capacity = capacity;
+  }
+
+  code->instructions[code->size++] = (ICInstruction) { .label = NO_STRING, .instruction = instruction };
+}
+
+// Marks the current end of the code as a jump target
+void append_label(IntermediaryCode* code, Label label) {
+  append_ic(code, ICNoop());
+  code->instructions[code->size - 1].label = label;
+}
+
+void remove_noops(IntermediaryCode* code) {
+  int size = 0;
+  for (int i = 0; i < code->size; i++) {
+    if (code->instructions[i].label != NO_STRING || !MATCHES(code->instructions[i].instruction, ICNoop)) {
+      code->instructions[size++] = code->instructions[i];
+    }
+  }
+  code->size = size;
+}
+
+// `value` as a float when `to_float` is set, as an int otherwise
+static Storage converted(Storage value, int to_float, IntermediaryCode* code) {
+  if (is_float(value) == to_float) {
+    return value;
+  }
+
+  Storage result = next_storage();
+  if (to_float) {
+    mark_float(result);
+  }
+  append_ic(code, ICConvert(result, value));
+  return result;
+}
+
+void make_intermediary_code_expression(
+    Expression expr, Storage* result, SymbolTable* symbols, IntermediaryCode* code
+) {
   // HACK: These two cases name their storage as custom values
   if (!MATCHES(expr, LiteralExpression) && !MATCHES(expr, IdentifierExpression)) {
     *result = next_storage();
@@ -92,63 +272,56 @@ IntermediaryCode* make_intermediary_code_expression(Expression expr, Storage* re
       // HACK: Name the storage for literals the same as their formatted value
       match(*literal) {
         of(IntLiteral, i) snprintf(buffer, sizeof(buffer), "$%d", *i);
-        of(FloatLiteral, f) snprintf(buffer, sizeof(buffer), "$%g", *f);
+        of(FloatLiteral, f) snprintf(buffer, sizeof(buffer), "%s", string_of(float_literal(*f)));
         of(CharLiteral, c) snprintf(buffer, sizeof(buffer), "$'%c'", *c);
-        of(StringLiteral, s) {
-          Storage storage = next_storage();
-          snprintf(buffer, sizeof(buffer), "%s", storage);
-
-          // HACK: Register string constant on global list
-          StringDeclarationList declaration = { .identifier = storage, .value = *s, .next = NULL };
-          StringDeclarationList* tail = string_constants;
-          while (string_constants != NULL && tail->next != NULL) {
-            tail = tail->next;
-          }
-          if (string_constants == NULL) {
-            string_constants = malloc(sizeof(StringDeclarationList));
-            *string_constants = declaration;
-          } else {
-            tail->next = malloc(sizeof(StringDeclarationList));
-            *(tail->next) = declaration;
-          }
-        }
+        of(StringLiteral, s) snprintf(buffer, sizeof(buffer), "%s", string_of(string_constant(*s)));
       }
-      *result = strdup(buffer);
-      return make_ic(ICNoop()); // TODO: This won't be a noop in the future
+      *result = intern(buffer);
     }
     of(IdentifierExpression, identifier) {
-      *result = strdup(*identifier); // HACK: Name the storage for identifier the same as their name
-      return make_ic(ICNoop());      // TODO: This won't be a noop in the future
+      *result = variable_storage(*identifier); // HACK: Name the storage for identifier the same as their name
     }
     of(ReadArrayExpression, identifier, index_expression) {
-      Storage index_result = NULL;
-      IntermediaryCode* index_code = make_intermediary_code_expression(**index_expression, &index_result, declarations);
-      IntermediaryCode* read_code = make_ic(ICCopyFrom(*result, *identifier, index_result));
-
-      return concat_ic(index_code, read_code);
+      Storage index_result = NO_STRING;
+      make_intermediary_code_expression(**index_expression, &index_result, symbols, code);
+      append_ic(code, ICCopyFrom(*result, *identifier, index_result));
+      if (is_float(*identifier)) {
+        mark_float(*result);
+      }
     }
     of(FunctionCallExpression, function_identifier, arguments) {
-      DeclarationSearchResult search_function = find_declaration(*function_identifier, declarations);
+      DeclarationSearchResult search_function = find_declaration(*function_identifier, symbols);
       match(search_function) {
         of(DeclarationFound, declaration) {
           match(*declaration) {
             of(FunctionDeclaration, _, _, params) {
-              IntermediaryCode* call_result = NULL;
-
+              int count = 0;
               ArgumentList* arguments_list = *arguments;
               ParametersDeclaration* parameters_list = *params;
               while (arguments_list != NULL && parameters_list != NULL) {
-                Storage arg_result = NULL;
-
-                call_result = concat_ic(
-                    call_result, make_intermediary_code_expression(arguments_list->argument, &arg_result, declarations)
-                );
-                call_result = concat_ic(call_result, make_ic(ICCopy(parameters_list->name, arg_result)));
+                count++;
+                arguments_list = arguments_list->next;
+                parameters_list = parameters_list->next;
+              }
 
+              // Evaluate every argument first, so calls nested in them don't get between ICArgument and ICCall
+              Storage argument_results[count];
+              arguments_list = *arguments;
+              parameters_list = *params;
+              for (int i = 0; i < count; i++) {
+                make_intermediary_code_expression(arguments_list->argument, &argument_results[i], symbols, code);
+                argument_results[i] =
+                    converted(argument_results[i], MATCHES(parameters_list->type, FloatType), code);
                 arguments_list = arguments_list->next;
                 parameters_list = parameters_list->next;
               }
-              return concat_ic(call_result, make_ic(ICCall(*function_identifier, *result)));
+              for (int i = 0; i < count; i++) {
+                append_ic(code, ICArgument(argument_results[i]));
+              }
+              append_ic(code, ICCall(*function_identifier, *result));
+              if (is_float(*function_identifier)) {
+                mark_float(*result);
+              }
             }
             otherwise { }
           }
@@ -156,201 +329,242 @@ IntermediaryCode* make_intermediary_code_expression(Expression expr, Storage* re
         otherwise { }
       }
     }
-    of(InputExpression, type) { return make_ic(ICInput(*type, *result)); }
+    of(InputExpression, type) {
+      append_ic(code, ICInput(*type, *result));
+      if (MATCHES(*type, FloatType)) {
+        mark_float(*result);
+      }
+    }
     of(BinaryExpression, operator, left, right) {
-      IntermediaryCode* binop_result = NULL;
-      Storage left_result = NULL;
-      Storage right_result = NULL;
+      Storage left_result = NO_STRING;
+      Storage right_result = NO_STRING;
 
-      binop_result = concat_ic(binop_result, make_intermediary_code_expression(**left, &left_result, declarations));
-      binop_result = concat_ic(binop_result, make_intermediary_code_expression(**right, &right_result, declarations));
-      binop_result = concat_ic(binop_result, make_ic(ICBinOp(*operator, * result, left_result, right_result)));
+      make_intermediary_code_expression(**left, &left_result, symbols, code);
+      make_intermediary_code_expression(**right, &right_result, symbols, code);
 
-      return binop_result;
+      // An int or char meeting a float is widened, and arithmetic on floats gives a float
+      if (is_float(left_result) || is_float(right_result)) {
+        left_result = converted(left_result, 1, code);
+        right_result = converted(right_result, 1, code);
+        match(*operator) {
+          of(SumOperator) mark_float(*result);
+          of(SubtractionOperator) mark_float(*result);
+          of(MultiplicationOperator) mark_float(*result);
+          of(DivisionOperator) mark_float(*result);
+          otherwise { }
+        }
+      }
+      append_ic(code, ICBinOp(*operator, * result, left_result, right_result));
     }
   }
-
-  // Not supposed to happen
-  return NULL;
 }
 
-IntermediaryCode* make_intermediary_code(const StatementList* current, DeclarationList* declarations) {
-  if (current == NULL) {
-    return make_ic(ICNoop());
-  }
+void make_intermediary_code(const StatementList* current, SymbolTable* symbols, IntermediaryCode* code);
 
-  match(current->statement) {
+void make_intermediary_code_statement(Statement statement, SymbolTable* symbols, IntermediaryCode* code) {
+  match(statement) {
     of(AssignmentStatement, identifier, expr) {
       Storage expr_result;
-      IntermediaryCode* expression = make_intermediary_code_expression(*expr, &expr_result, declarations);
-      IntermediaryCode* rest = make_intermediary_code(current->next, declarations);
-
-      IntermediaryCode* result = NULL;
-      result = concat_ic(result, expression);
-      result = concat_ic(result, make_ic(ICCopy(*identifier, expr_result)));
-      result = concat_ic(result, rest);
-      return result;
+      make_intermediary_code_expression(*expr, &expr_result, symbols, code);
+      Storage variable = variable_storage(*identifier);
+      append_ic(code, ICCopy(variable, converted(expr_result, is_float(variable), code)));
     }
     of(ArrayAssignmentStatement, identifier, index_expr, expr) {
       Storage expr_result;
-      IntermediaryCode* expression = make_intermediary_code_expression(*expr, &expr_result, declarations);
+      make_intermediary_code_expression(*expr, &expr_result, symbols, code);
       Storage index_expr_result;
-      IntermediaryCode* index_expression =
-          make_intermediary_code_expression(*index_expr, &index_expr_result, declarations);
-
-      IntermediaryCode* rest = make_intermediary_code(current->next, declarations);
-
-      IntermediaryCode* result = NULL;
-      result = concat_ic(result, expression);
-      result = concat_ic(result, index_expression);
-      result = concat_ic(result, make_ic(ICCopyAt(*identifier, index_expr_result, expr_result)));
-      result = concat_ic(result, rest);
-      return result;
+      make_intermediary_code_expression(*index_expr, &index_expr_result, symbols, code);
+      expr_result = converted(expr_result, is_float(*identifier), code);
+      append_ic(code, ICCopyAt(*identifier, index_expr_result, expr_result));
     }
     of(PrintStatement, expr) {
       Storage expr_result;
-      IntermediaryCode* expression = make_intermediary_code_expression(*expr, &expr_result, declarations);
-      IntermediaryCode* rest = make_intermediary_code(current->next, declarations);
-
-      IntermediaryCode* result = NULL;
-      result = concat_ic(result, expression);
-      result = concat_ic(result, make_ic(ICPrint(expr_result)));
-      result = concat_ic(result, rest);
-      return result;
+      make_intermediary_code_expression(*expr, &expr_result, symbols, code);
+      append_ic(code, ICPrint(expr_result));
     }
     of(ReturnStatement, expr) {
       Storage expr_result;
-      IntermediaryCode* expression = make_intermediary_code_expression(*expr, &expr_result, declarations);
-      IntermediaryCode* rest = make_intermediary_code(current->next, declarations);
-
-      IntermediaryCode* result = NULL;
-      result = concat_ic(result, expression);
-      result = concat_ic(result, make_ic(ICReturn(expr_result)));
-      result = concat_ic(result, rest);
-      return result;
+      make_intermediary_code_expression(*expr, &expr_result, symbols, code);
+      append_ic(code, ICReturn(converted(expr_result, is_float(current_function), code)));
     }
     of(IfStatement, cond, true_statement) {
+      Label rest = next_label();
+
       Storage condition_result;
-      IntermediaryCode* condition = make_intermediary_code_expression(*cond, &condition_result, declarations);
-      IntermediaryCode* true_branch = make_intermediary_code(from_statement(**true_statement), declarations);
-      IntermediaryCode* rest = with_label(make_intermediary_code(current->next, declarations), next_label());
-
-      IntermediaryCode* result = NULL;
-      result = concat_ic(result, condition);
-      result = concat_ic(result, make_ic(ICJumpIfFalse(condition_result, rest->label)));
-      result = concat_ic(result, true_branch);
-      result = concat_ic(result, rest);
-      return result;
+      make_intermediary_code_expression(*cond, &condition_result, symbols, code);
+      append_ic(code, ICJumpIfFalse(condition_result, rest));
+      make_intermediary_code_statement(**true_statement, symbols, code);
+      append_label(code, rest);
     }
     of(IfElseStatement, cond, true_statement, false_statement) {
+      Label false_branch = next_label();
+      Label rest = next_label();
+
       Storage condition_result;
-      IntermediaryCode* condition = make_intermediary_code_expression(*cond, &condition_result, declarations);
-      IntermediaryCode* true_branch = make_intermediary_code(from_statement(**true_statement), declarations);
-      IntermediaryCode* false_branch =
-          with_label(make_intermediary_code(from_statement(**false_statement), declarations), next_label());
-      IntermediaryCode* rest = with_label(make_intermediary_code(current->next, declarations), next_label());
-
-      IntermediaryCode* result = NULL;
-      result = concat_ic(result, condition);
-      result = concat_ic(result, make_ic(ICJumpIfFalse(condition_result, false_branch->label)));
-      result = concat_ic(result, true_branch);
-      result = concat_ic(result, make_ic(ICJump(rest->label)));
-      result = concat_ic(result, false_branch);
-      result = concat_ic(result, rest);
-      return result;
+      make_intermediary_code_expression(*cond, &condition_result, symbols, code);
+      append_ic(code, ICJumpIfFalse(condition_result, false_branch));
+      make_intermediary_code_statement(**true_statement, symbols, code);
+      append_ic(code, ICJump(rest));
+      append_label(code, false_branch);
+      make_intermediary_code_statement(**false_statement, symbols, code);
+      append_label(code, rest);
     }
     of(WhileStatement, cond, body) {
+      Label condition = next_label();
+      Label rest = next_label();
+
       Storage condition_result;
-      IntermediaryCode* condition =
-          with_label(make_intermediary_code_expression(*cond, &condition_result, declarations), next_label());
-      IntermediaryCode* loop_body = make_intermediary_code(from_statement(**body), declarations);
-      IntermediaryCode* rest = with_label(make_intermediary_code(current->next, declarations), next_label());
-
-      IntermediaryCode* result = NULL;
-      result = concat_ic(result, condition);
-      result = concat_ic(result, make_ic(ICJumpIfFalse(condition_result, rest->label)));
-      result = concat_ic(result, loop_body);
-      result = concat_ic(result, make_ic(ICJump(condition->label)));
-      result = concat_ic(result, rest);
-      return result;
-    }
-    of(BlockStatement, list) {
-      return concat_ic(
-          make_intermediary_code(*list, declarations), make_intermediary_code(current->next, declarations)
-      );
+      append_label(code, condition);
+      make_intermediary_code_expression(*cond, &condition_result, symbols, code);
+      append_ic(code, ICJumpIfFalse(condition_result, rest));
+      make_intermediary_code_statement(**body, symbols, code);
+      append_ic(code, ICJump(condition));
+      append_label(code, rest);
     }
-    of(EmptyStatement) { return make_intermediary_code(current->next, declarations); }
+    of(BlockStatement, list) make_intermediary_code(*list, symbols, code);
+    of(EmptyStatement) { }
   }
+}
 
-  // Should never happen
-  return NULL;
+void make_intermediary_code(const StatementList* current, SymbolTable* symbols, IntermediaryCode* code) {
+  while (current != NULL) {
+    make_intermediary_code_statement(current->statement, symbols, code);
+    current = current->next;
+  }
 }
 
-IntermediaryCode* intemediary_code_from_program(Program program) {
-  IntermediaryCode* result = NULL;
+IntermediaryCode* intemediary_code_from_program(Program program, SymbolTable* symbols) {
+  IntermediaryCode* result = arena_alloc(&intermediary_code_arena, sizeof(IntermediaryCode));
+  *result = (IntermediaryCode) { .instructions = NULL, .size = 0, .capacity = 0 };
+
+  // Globals and functions are their own storages, so their types are known before any code refers to them
+  for (DeclarationList* list = program.declarations; list != NULL; list = list->next) {
+    match(list->declaration) {
+      of(VariableDeclaration, type, identifier) {
+        if (MATCHES(*type, FloatType)) {
+          mark_float(*identifier);
+        }
+      }
+      of(ArrayDeclaration, type, identifier) {
+        if (MATCHES(*type, FloatType)) {
+          mark_float(*identifier);
+        }
+      }
+      of(FunctionDeclaration, type, identifier) {
+        if (MATCHES(*type, FloatType)) {
+          mark_float(*identifier);
+        }
+      }
+    }
+  }
 
   ImplementationList* implementations = program.implementations;
   while (implementations != NULL) {
-    result = concat_ic(result, make_ic(ICFunctionBegin(implementations->implementation.name)));
-    result = concat_ic(
-        result, make_intermediary_code(from_statement(implementations->implementation.body), program.declarations)
-    );
-    result = concat_ic(result, make_ic(ICFunctionEnd()));
+    current_function = implementations->implementation.name;
+    current_parameters = NULL;
+    DeclarationSearchResult search_function = find_declaration(current_function, symbols);
+    match(search_function) {
+      of(DeclarationFound, declaration) {
+        match(*declaration) {
+          of(FunctionDeclaration, _, _, parameters) current_parameters = *parameters;
+          otherwise { }
+        }
+      }
+      otherwise { }
+    }
+
+    append_ic(result, ICFunctionBegin(current_function));
+    for (ParametersDeclaration* parameter = current_parameters; parameter != NULL; parameter = parameter->next) {
+      Storage storage = local_variable(current_function, string_of(parameter->name));
+      if (MATCHES(parameter->type, FloatType)) {
+        mark_float(storage);
+      }
+      append_ic(result, ICParameter(storage));
+    }
+    make_intermediary_code_statement(implementations->implementation.body, symbols, result);
+    append_ic(result, ICFunctionEnd());
     implementations = implementations->next;
   }
+  current_function = NO_STRING;
+  current_parameters = NULL;
 
   return result;
 }
 
-void print_intermediary_code(IntermediaryCode* code) {
-  while (code != NULL) {
-    if (code->label != NULL) {
-      printf("LABEL(name = %s)\n", code->label);
+void print_ic_instruction(FILE* out, IC* instruction) {
+  match(*instruction) {
+    of(ICNoop) fprintf(out, "NOOP()");
+    of(ICFunctionBegin, name) fprintf(out, "FUNCTION_BEGIN(name = %s)", string_of(*name));
+    of(ICFunctionEnd) fprintf(out, "FUNCTION_END()");
+    of(ICJump, label) { fprintf(out, "JUMP(goto = %s)", string_of(*label)); }
+    of(ICJumpIfFalse, storage, label) {
+      fprintf(out, "JUMP_IF_FALSE(read = %s, goto = %s)", string_of(*storage), string_of(*label));
     }
-
-    match(code->instruction) {
-      of(ICNoop) { }
-      of(ICFunctionBegin, name) printf("FUNCTION_BEGIN(name = %s)\n", *name);
-      of(ICFunctionEnd) printf("FUNCTION_END()\n");
-      of(ICJump, label) { printf("JUMP(goto = %s)\n", *label); }
-      of(ICJumpIfFalse, storage, label) { printf("JUMP_IF_FALSE(read = %s, goto = %s)\n", *storage, *label); }
-      of(ICCopy, dst, src) { printf("COPY(destination = %s, source = %s)\n", *dst, *src); }
-      of(ICCopyAt, dst, idx, src) { printf("COPY_TO_ARRAY(destination = %s[%s], source = %s)\n", *dst, *idx, *src); }
-      of(ICCopyFrom, dst, src, idx) {
-        printf("COPY_FROM_ARRAY(destination = %s, source = %s[%s])\n", *dst, *src, *idx);
-      }
-      of(ICCall, name, dst) printf("CALL(identifier = %s, destination = %s)\n", *name, *dst);
-      of(ICInput, type, dst) {
-        printf("INPUT(type = ");
-        match(*type) {
-          of(IntegerType) printf("INT");
-          of(FloatType) printf("FLOAT");
-          of(CharType) printf("CHAR");
-        }
-        printf(", destination = %s)\n", *dst);
+    of(ICCopy, dst, src) { fprintf(out, "COPY(destination = %s, source = %s)", string_of(*dst), string_of(*src)); }
+    of(ICCopyAt, dst, idx, src) {
+      fprintf(
+          out, "COPY_TO_ARRAY(destination = %s[%s], source = %s)", string_of(*dst), string_of(*idx), string_of(*src)
+      );
+    }
+    of(ICCopyFrom, dst, src, idx) {
+      fprintf(
+          out, "COPY_FROM_ARRAY(destination = %s, source = %s[%s])", string_of(*dst), string_of(*src), string_of(*idx)
+      );
+    }
+    of(ICCall, name, dst) fprintf(out, "CALL(identifier = %s, destination = %s)", string_of(*name), string_of(*dst));
+    of(ICInput, type, dst) {
+      fprintf(out, "INPUT(type = ");
+      match(*type) {
+        of(IntegerType) fprintf(out, "INT");
+        of(FloatType) fprintf(out, "FLOAT");
+        of(CharType) fprintf(out, "CHAR");
       }
-      of(ICPrint, src) printf("PRINT(src = %s)\n", *src);
-      of(ICReturn, src) printf("RETURN(src = %s)\n", *src);
-      of(ICBinOp, operator, dst, left, right) {
-        match(*operator) {
-          of(SumOperator) printf("SUM");
-          of(SubtractionOperator) printf("SUB");
-          of(MultiplicationOperator) printf("MUL");
-          of(DivisionOperator) printf("DIV");
-          of(LessThanOperator) printf("LT");
-          of(GreaterThanOperator) printf("GT");
-          of(AndOperator) printf("AND");
-          of(OrOperator) printf("OR");
-          of(NotOperator) printf("NOT");
-          of(LessOrEqualOperator) printf("LE");
-          of(GreaterOrEqualOperator) printf("GE");
-          of(EqualsOperator) printf("EQUALS");
-          of(DiffersOperator) printf("DIFFERS");
-        }
-        printf("(destination = %s, operand_left = %s, operand_right = %s)\n", *dst, *left, *right);
+      fprintf(out, ", destination = %s)", string_of(*dst));
+    }
+    of(ICPrint, src) fprintf(out, "PRINT(src = %s)", string_of(*src));
+    of(ICReturn, src) fprintf(out, "RETURN(src = %s)", string_of(*src));
+    of(ICArgument, src) fprintf(out, "ARGUMENT(src = %s)", string_of(*src));
+    of(ICParameter, dst) fprintf(out, "PARAMETER(destination = %s)", string_of(*dst));
+    of(ICCheckBounds, index, length) fprintf(out, "CHECK_BOUNDS(index = %s, length = %d)", string_of(*index), *length);
+    of(ICConvert, dst, src) {
+      fprintf(out, "CONVERT(destination = %s, source = %s)", string_of(*dst), string_of(*src));
+    }
+    of(ICBinOp, operator, dst, left, right) {
+      match(*operator) {
+        of(SumOperator) fprintf(out, "SUM");
+        of(SubtractionOperator) fprintf(out, "SUB");
+        of(MultiplicationOperator) fprintf(out, "MUL");
+        of(DivisionOperator) fprintf(out, "DIV");
+        of(LessThanOperator) fprintf(out, "LT");
+        of(GreaterThanOperator) fprintf(out, "GT");
+        of(AndOperator) fprintf(out, "AND");
+        of(OrOperator) fprintf(out, "OR");
+        of(NotOperator) fprintf(out, "NOT");
+        of(LessOrEqualOperator) fprintf(out, "LE");
+        of(GreaterOrEqualOperator) fprintf(out, "GE");
+        of(EqualsOperator) fprintf(out, "EQUALS");
+        of(DiffersOperator) fprintf(out, "DIFFERS");
       }
+      fprintf(
+          out, "(destination = %s, operand_left = %s, operand_right = %s)", string_of(*dst), string_of(*left),
+          string_of(*right)
+      );
     }
+  }
+}
+
+void print_intermediary_code(FILE* out, IntermediaryCode* code) {
+  for (int i = 0; i < code->size; i++) {
+    ICInstruction* current = &code->instructions[i];
 
-    code = code->next;
+    if (current->label != NO_STRING) {
+      fprintf(out, "LABEL(name = %s)\n", string_of(current->label));
+    }
+
+    // Noops only ever carry labels
+    if (!MATCHES(current->instruction, ICNoop)) {
+      print_ic_instruction(out, &current->instruction);
+      fprintf(out, "\n");
+    }
   }
 }
\ No newline at end of file
@@ -1,17 +1,18 @@
 #ifndef INTERMEDIARY_CODE_H
 #define INTERMEDIARY_CODE_H
 
+#include "symbol-table.h"
 #include "syntax-tree.h"
 
 #include <datatype99.h>
 #include <stdio.h>
 
-typedef char* Label;
-typedef char* Storage;
+typedef StringId Label;
+typedef StringId Storage;
 
 // HACK: Huuuuuge hack to create the string constants later
 typedef struct StringDeclarationList {
-  char* identifier;
+  Storage identifier;
   char* value;
   struct StringDeclarationList* next;
 } StringDeclarationList;
@@ -21,17 +22,76 @@ datatype(
     (ICCopyAt, Storage, Storage, Storage), (ICCopyFrom, Storage, Storage, Storage), (ICCall, Identifier, Storage),
     (ICInput, Type, Storage), (ICBinOp, BinaryOperator, Storage, Storage, Storage), (ICPrint, Storage),
     (ICReturn, Storage),
+    // Arguments are collected by the ICArgument instructions right before an ICCall, in order
+    (ICArgument, Storage),
     // TODO: Do I really need these ones?
-    (ICFunctionBegin, Identifier), (ICFunctionEnd)
+    (ICFunctionBegin, Identifier), (ICFunctionEnd),
+    // Right after ICFunctionBegin, one per parameter in order. Defines the parameter with its argument
+    (ICParameter, Storage),
+    // With -fbounds-check, right before an array access: stops the program unless 0 <= index < length
+    (ICCheckBounds, Storage, int),
+    // Between int and float, whichever way around the float flags of the two storages say. Floats become ints
+    // truncated toward zero
+    (ICConvert, Storage, Storage)
 );
 
-typedef struct IntermediaryCode {
-  struct IntermediaryCode* next;
+typedef struct ICInstruction {
   Label label;
   IC instruction;
+} ICInstruction;
+
+// Instructions are stored contiguously, generation only ever appends to the end
+typedef struct IntermediaryCode {
+  ICInstruction* instructions;
+  int size;
+  int capacity;
 } IntermediaryCode;
 
-IntermediaryCode* intemediary_code_from_program(Program);
-void print_intermediary_code(IntermediaryCode*);
+extern Arena intermediary_code_arena;
+extern StringDeclarationList* string_constants;
+extern int string_constant_count;
+extern int temporary_count;
+
+// Temporaries are only ever written once, by the instruction that computes them
+int is_temporary(Storage);
+// Parameters are named after their function (`fact.n`), since each call has its own copy. Unlike temporaries, these
+// variables can be written any number of times
+int is_local_variable(Storage);
+// Storage private to one function call: temporaries and local variables
+int is_local(Storage);
+// Immediates, named after their value (`$42`, `$'c'`, `$1.5`)
+int is_literal(Storage);
+// Holds a float: variables, arrays and functions declared as such, and the literals and temporaries of that type
+int is_float(Storage);
+void mark_float(Storage);
+
+// Collects pointers to the storages `instruction` reads, returns how many there are
+int ic_uses(IC* instruction, Storage* uses[3]);
+// Storage written by `instruction`, or NULL
+Storage* ic_definition(IC* instruction);
+
+Label next_label();
+Storage next_storage();
+// Constant holding the text of a string literal, the same one for every identical literal
+Storage string_constant(char* value);
+// Local variable `function.name`
+Storage local_variable(Identifier function, const char* name);
+// Fresh local of the same kind and type as `local`
+Storage copy_of_local(Storage local);
+// Named with enough digits to give back `value` exactly, and always with a point or an exponent so it can't be taken
+// for an int literal
+Storage float_literal(float value);
+// Value of a float literal. Fails for anything else
+int float_literal_value(Storage storage, float* value);
+
+void append_ic(IntermediaryCode* code, IC instruction);
+// Marks the current end of the code as a jump target
+void append_label(IntermediaryCode* code, Label label);
+// Removes the noops that do not carry a label
+void remove_noops(IntermediaryCode* code);
+
+IntermediaryCode* intemediary_code_from_program(Program, SymbolTable*);
+void print_ic_instruction(FILE*, IC*);
+void print_intermediary_code(FILE*, IntermediaryCode*);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,127 @@
+#include "liveness.h"
+
+#include <string.h>
+
+static TemporarySet make_set(int count) {
+  TemporarySet set = arena_alloc(&intermediary_code_arena, SET_WORDS(count) * sizeof(uint64_t));
+  memset(set, 0, SET_WORDS(count) * sizeof(uint64_t));
+  return set;
+}
+
+int temporary_index(Liveness* liveness, Storage storage) {
+  return storage < liveness->index_count ? liveness->index_of[storage] : -1;
+}
+
+static int storages_of(IC* instruction, Storage* storages[4]) {
+  int count = ic_uses(instruction, storages);
+  Storage* definition = ic_definition(instruction);
+  if (definition != NULL) {
+    storages[count++] = definition;
+  }
+  return count;
+}
+
+static void number_temporaries(IntermediaryCode* code, FunctionCFG* function, Liveness* liveness, int f) {
+  FunctionLiveness* result = &liveness->functions[f];
+
+  // Every mention is an upper bound on how many distinct temporaries there are
+  int mentions = 0;
+  for (int i = function->begin; i < function->end; i++) {
+    Storage* storages[4];
+    mentions += storages_of(&code->instructions[i].instruction, storages);
+  }
+  result->temporaries = arena_alloc(&intermediary_code_arena, mentions * sizeof(Storage));
+  result->temporary_count = 0;
+
+  for (int i = function->begin; i < function->end; i++) {
+    Storage* storages[4];
+    int count = storages_of(&code->instructions[i].instruction, storages);
+    for (int j = 0; j < count; j++) {
+      Storage storage = *storages[j];
+      if (is_local(storage) && liveness->index_of[storage] == -1) {
+        liveness->index_of[storage] = result->temporary_count;
+        result->temporaries[result->temporary_count++] = storage;
+      }
+    }
+  }
+}
+
+static void solve(IntermediaryCode* code, FunctionCFG* function, Liveness* liveness, int f) {
+  FunctionLiveness* result = &liveness->functions[f];
+  int count = result->temporary_count;
+  int words = SET_WORDS(count);
+
+  TemporarySet* used = arena_alloc(&intermediary_code_arena, function->block_count * sizeof(TemporarySet));
+  TemporarySet* defined = arena_alloc(&intermediary_code_arena, function->block_count * sizeof(TemporarySet));
+  result->live_in = arena_alloc(&intermediary_code_arena, function->block_count * sizeof(TemporarySet));
+  result->live_out = arena_alloc(&intermediary_code_arena, function->block_count * sizeof(TemporarySet));
+
+  for (int b = 0; b < function->block_count; b++) {
+    used[b] = make_set(count);
+    defined[b] = make_set(count);
+    result->live_in[b] = make_set(count);
+    result->live_out[b] = make_set(count);
+
+    // Upwards exposed uses and definitions, in order
+    for (int i = function->blocks[b].first; i < function->blocks[b].last; i++) {
+      IC* instruction = &code->instructions[i].instruction;
+
+      Storage* uses[3];
+      int use_count = ic_uses(instruction, uses);
+      for (int u = 0; u < use_count; u++) {
+        int index = temporary_index(liveness, *uses[u]);
+        if (index != -1 && !SET_CONTAINS(defined[b], index)) {
+          SET_INSERT(used[b], index);
+        }
+      }
+
+      Storage* definition = ic_definition(instruction);
+      int index = definition == NULL ? -1 : temporary_index(liveness, *definition);
+      if (index != -1) {
+        SET_INSERT(defined[b], index);
+      }
+    }
+  }
+
+  // Backwards problem, so visiting blocks in postorder converges quickly
+  int changed = 1;
+  while (changed) {
+    changed = 0;
+    for (int i = function->reachable_count - 1; i >= 0; i--) {
+      int b = function->reverse_postorder[i];
+      BasicBlock* block = &function->blocks[b];
+      TemporarySet out = result->live_out[b];
+      TemporarySet in = result->live_in[b];
+
+      for (int s = 0; s < block->successor_count; s++) {
+        TemporarySet successor_in = result->live_in[block->successors[s]];
+        for (int w = 0; w < words; w++) {
+          out[w] |= successor_in[w];
+        }
+      }
+
+      for (int w = 0; w < words; w++) {
+        uint64_t updated = used[b][w] | (out[w] & ~defined[b][w]);
+        if (updated != in[w]) {
+          in[w] = updated;
+          changed = 1;
+        }
+      }
+    }
+  }
+}
+
+Liveness* analyze_liveness(IntermediaryCode* code, CFG* cfg) {
+  Liveness* liveness = arena_alloc(&intermediary_code_arena, sizeof(Liveness));
+  liveness->functions = arena_alloc(&intermediary_code_arena, cfg->function_count * sizeof(FunctionLiveness));
+  liveness->index_count = interned_count();
+  liveness->index_of = arena_alloc(&intermediary_code_arena, liveness->index_count * sizeof(int));
+  memset(liveness->index_of, 0xff, liveness->index_count * sizeof(int));
+
+  for (int f = 0; f < cfg->function_count; f++) {
+    number_temporaries(code, &cfg->functions[f], liveness, f);
+    solve(code, &cfg->functions[f], liveness, f);
+  }
+
+  return liveness;
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#ifndef LIVENESS_H
+#define LIVENESS_H
+
+#include "cfg.h"
+
+#include <stdint.h>
+
+// Sets of locals (temporaries and local variables), one bit per local of the function. They're all called temporaries
+// here, variables only differ in being written more than once
+typedef uint64_t* TemporarySet;
+
+#define SET_WORDS(count)      (((count) + 63) / 64)
+#define SET_CONTAINS(set, i)  (((set)[(i) / 64] >> ((i) % 64)) & 1)
+#define SET_INSERT(set, i)    ((set)[(i) / 64] |= (uint64_t)1 << ((i) % 64))
+#define SET_REMOVE(set, i)    ((set)[(i) / 64] &= ~((uint64_t)1 << ((i) % 64)))
+
+// Temporaries live at the boundaries of each block of one function
+typedef struct FunctionLiveness {
+  Storage* temporaries; // Every temporary the function mentions, dense index -> storage
+  int temporary_count;
+
+  TemporarySet* live_in;  // Per block
+  TemporarySet* live_out; // Per block
+} FunctionLiveness;
+
+typedef struct Liveness {
+  FunctionLiveness* functions; // Same order as the CFG's
+
+  // Dense index of each local inside the one function that uses it, -1 for anything else. Indexed by StringId
+  int* index_of;
+  uint32_t index_count;
+} Liveness;
+
+// Lives in intermediary_code_arena, it must be recomputed whenever the code changes
+Liveness* analyze_liveness(IntermediaryCode* code, CFG* cfg);
+
+// -1 when `storage` is not a local
+int temporary_index(Liveness* liveness, Storage storage);
+
+#endif
\ No newline at end of file
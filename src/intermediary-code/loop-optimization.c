@@ -0,0 +1,475 @@
+#include "cfg.h"
+#include "liveness.h"
+#include "optimizations.h"
+
+#include <string.h>
+
+int invariants_hoisted = 0;
+int multiplications_reduced = 0;
+
+// `reduced` equals `variable * factor` all through the loop: it's computed in the preheader and moves by `step` right
+// after every write of `variable`
+typedef struct Reduction {
+  Storage variable;
+  Storage factor;
+  Storage reduced;
+  Storage increment; // How much `variable` moves by, `step` is this times `factor`
+  Storage step;
+  BinaryOperator update;
+  int after; // Index of the instruction writing `variable`
+  int next;  // Next reduction to update after the same instruction, -1 at the end
+} Reduction;
+
+// Runs once on the way into a loop, placed right before its header
+typedef struct Preheader {
+  int header;  // Index of the header's first instruction
+  Label label; // NO_STRING when everything gets in by falling through
+  int* hoisted;
+  int hoisted_count;
+  int first_reduction; // Reductions of the loop, contiguous
+  int reduction_count;
+} Preheader;
+
+// One pass over every loop in the code, each pass after the first can take out what the previous one hoisted into an
+// enclosing loop
+typedef struct LoopPass {
+  IntermediaryCode* code;
+  Liveness* liveness;
+  uint32_t size; // Names interned when the pass started, the arrays below are that big
+
+  int* definitions;      // Per name, in the whole function
+  int* loop_stamp;       // Per name: `loop_definitions` and `defined_at` are about the loop with this stamp
+  int* loop_definitions; // Per name, stores into an array count for it too
+  int* defined_at;       // Per name: index of its last definition in the loop
+  int* invariant_stamp;  // Per name: hoisted out of the loop with this stamp
+  int stamp;
+
+  char* moved;       // Per instruction
+  int* first_update; // Per instruction: first reduction to update after it, -1 for none
+
+  Preheader* preheaders;
+  int preheader_count;
+  Reduction* reductions;
+  int reduction_count;
+  int reduction_capacity;
+} LoopPass;
+
+static void* make_array(int count, size_t size) {
+  void* array = arena_alloc(&intermediary_code_arena, count * size);
+  memset(array, 0, count * size);
+  return array;
+}
+
+static int loop_definitions(LoopPass* pass, Storage storage) {
+  if (storage >= pass->size) {
+    return 1;
+  }
+  return pass->loop_stamp[storage] == pass->stamp ? pass->loop_definitions[storage] : 0;
+}
+
+// Holds the same value all through the loop. A global could still be changed by a call
+static int is_invariant(LoopPass* pass, Storage storage, int has_call) {
+  if (is_literal(storage)) {
+    return 1;
+  }
+  if (storage >= pass->size) {
+    return 0;
+  }
+  if (pass->invariant_stamp[storage] == pass->stamp) {
+    return 1;
+  }
+  return loop_definitions(pass, storage) == 0 && (is_local(storage) || !has_call);
+}
+
+static void count_definition(LoopPass* pass, Storage storage, int index) {
+  if (storage >= pass->size) {
+    return;
+  }
+  if (pass->loop_stamp[storage] != pass->stamp) {
+    pass->loop_stamp[storage] = pass->stamp;
+    pass->loop_definitions[storage] = 0;
+  }
+  pass->loop_definitions[storage]++;
+  pass->defined_at[storage] = index;
+}
+
+// Whether running the instruction in the preheader is the same as running it where it is. Division and array reads
+// could trap, so those must be sure to run anyway, from a block that every way out of the loop goes through. Array
+// reads also stay behind the bounds checks that guard them
+static int can_hoist(
+    LoopPass* pass, IC* instruction, int has_call, int has_check, int always_runs, TemporarySet live_in
+) {
+  Storage* definition = ic_definition(instruction);
+  if (definition == NULL || !is_local(*definition) || *definition >= pass->size ||
+      pass->definitions[*definition] != 1) {
+    return 0;
+  }
+  // A value from the previous iteration can't come from the preheader
+  int index = temporary_index(pass->liveness, *definition);
+  if (index == -1 || SET_CONTAINS(live_in, index)) {
+    return 0;
+  }
+
+  int hoist = 0;
+  match(*instruction) {
+    of(ICBinOp, operator, _, left, right) {
+      int divisor;
+      int safe = !MATCHES(*operator, DivisionOperator) || always_runs ||
+                 (literal_value(*right, &divisor) && divisor != 0 && divisor != -1);
+      hoist = safe && is_invariant(pass, *left, has_call) && is_invariant(pass, *right, has_call);
+    }
+    of(ICCopyFrom, _, array, position) {
+      int unchanged = !has_call && loop_definitions(pass, *array) == 0;
+      hoist = always_runs && unchanged && !has_check && is_invariant(pass, *position, has_call);
+    }
+    of(ICCopy, _, src) hoist = !is_local(*src) && !is_literal(*src) && is_invariant(pass, *src, has_call);
+    of(ICConvert, _, src) hoist = is_invariant(pass, *src, has_call);
+    otherwise { }
+  }
+  return hoist;
+}
+
+// When `variable` is only written in the loop by adding or subtracting an invariant from itself, either directly or
+// through a temporary it's then copied from. Returns the index of the write, -1 when it isn't
+static int find_induction(LoopPass* pass, Storage variable, int has_call, Storage* increment, BinaryOperator* update) {
+  if (variable >= pass->size || !is_local(variable) || loop_definitions(pass, variable) != 1) {
+    return -1;
+  }
+  int write = pass->defined_at[variable];
+  int step = write;
+  Storage stepped = variable;
+  match(pass->code->instructions[write].instruction) {
+    of(ICCopy, _, src) {
+      if (*src < pass->size && is_local(*src) && loop_definitions(pass, *src) == 1 && pass->definitions[*src] == 1) {
+        stepped = *src;
+        step = pass->defined_at[*src];
+      }
+    }
+    otherwise { }
+  }
+
+  int found = 0;
+  match(pass->code->instructions[step].instruction) {
+    of(ICBinOp, operator, dst, left, right) {
+      int is_sum = MATCHES(*operator, SumOperator);
+      if (*dst == stepped && (is_sum || MATCHES(*operator, SubtractionOperator)) && *left == variable &&
+          is_invariant(pass, *right, has_call)) {
+        *increment = *right;
+        found = 1;
+      } else if (*dst == stepped && is_sum && *right == variable && is_invariant(pass, *left, has_call)) {
+        *increment = *left;
+        found = 1;
+      }
+      *update = *operator;
+    }
+    otherwise { }
+  }
+  return found ? write : -1;
+}
+
+static Reduction* add_reduction(LoopPass* pass) {
+  if (pass->reduction_count == pass->reduction_capacity) {
+    int grown = pass->reduction_capacity == 0 ? 8 : pass->reduction_capacity * 2;
+    pass->reductions = arena_realloc(
+        &intermediary_code_arena, pass->reductions, pass->reduction_capacity * sizeof(Reduction),
+        grown * sizeof(Reduction)
+    );
+    pass->reduction_capacity = grown;
+  }
+  return &pass->reductions[pass->reduction_count++];
+}
+
+// `t = i * k` with `i` an induction variable and `k` invariant becomes a copy of a variable kept equal to it by
+// additions
+static void reduce_multiplication(LoopPass* pass, FunctionCFG* function, Preheader* preheader, int at, int has_call) {
+  Storage variable = NO_STRING, factor = NO_STRING, dst = NO_STRING;
+  match(pass->code->instructions[at].instruction) {
+    of(ICBinOp, operator, destination, left, right) {
+      if (MATCHES(*operator, MultiplicationOperator)) {
+        dst = *destination;
+        variable = is_invariant(pass, *right, has_call) ? *left : *right;
+        factor = is_invariant(pass, *right, has_call) ? *right : *left;
+      }
+    }
+    otherwise { }
+  }
+  // Float additions round differently than the multiplication they would replace
+  if (dst == NO_STRING || !is_local(dst) || is_float(dst) || !is_invariant(pass, factor, has_call)) {
+    return;
+  }
+
+  Storage increment;
+  BinaryOperator update;
+  int write = find_induction(pass, variable, has_call, &increment, &update);
+  if (write == -1) {
+    return;
+  }
+
+  Reduction* reduction = NULL;
+  for (int r = preheader->first_reduction; r < pass->reduction_count && reduction == NULL; r++) {
+    if (pass->reductions[r].variable == variable && pass->reductions[r].factor == factor) {
+      reduction = &pass->reductions[r];
+    }
+  }
+  if (reduction == NULL) {
+    // The step is computed in the preheader, unless both sides are known
+    int left, right, product;
+    Storage step = NO_STRING;
+    if (literal_value(increment, &left) && literal_value(factor, &right)) {
+      evaluate(MultiplicationOperator(), left, right, &product);
+      step = make_literal(product);
+    } else {
+      step = next_storage();
+    }
+
+    reduction = add_reduction(pass);
+    *reduction = (Reduction) {
+      .variable = variable,
+      .factor = factor,
+      .reduced = copy_of_local(local_variable(function->name, "reduced")),
+      .increment = increment,
+      .step = step,
+      .update = update,
+      .after = write,
+      .next = pass->first_update[write],
+    };
+    pass->first_update[write] = reduction - pass->reductions;
+    preheader->reduction_count++;
+  }
+
+  pass->code->instructions[at].instruction = ICCopy(dst, reduction->reduced);
+  multiplications_reduced++;
+}
+
+static void optimize_loop(LoopPass* pass, FunctionCFG* function, Loop* loop, FunctionLiveness* live) {
+  BasicBlock* header = &function->blocks[loop->header];
+  ICInstruction* header_instruction = &pass->code->instructions[header->first];
+  if (loop->header == 0 || header->first == header->last || header_instruction->label == NO_STRING) {
+    return;
+  }
+  // The preheader goes right before the header, so nothing in the loop may fall into it
+  for (int b = 0; b < loop->block_count; b++) {
+    if (loop->blocks[b] == loop->header - 1) {
+      return;
+    }
+  }
+
+  pass->stamp++;
+  int has_call = 0;
+  int has_check = 0;
+  for (int b = 0; b < loop->block_count; b++) {
+    BasicBlock* block = &function->blocks[loop->blocks[b]];
+    for (int i = block->first; i < block->last; i++) {
+      IC* instruction = &pass->code->instructions[i].instruction;
+      Storage* definition = ic_definition(instruction);
+      if (definition != NULL) {
+        count_definition(pass, *definition, i);
+      }
+      match(*instruction) {
+        of(ICCopyAt, array, _, _) count_definition(pass, *array, i);
+        of(ICCall, _, _) has_call = 1;
+        of(ICCheckBounds, _, _) has_check = 1;
+        otherwise { }
+      }
+    }
+  }
+
+  // Blocks where the loop can be left from
+  char* in_loop = make_array(function->block_count, sizeof(char));
+  for (int b = 0; b < loop->block_count; b++) {
+    in_loop[loop->blocks[b]] = 1;
+  }
+  int* exits = make_array(loop->block_count, sizeof(int));
+  int exit_count = 0;
+  for (int b = 0; b < loop->block_count; b++) {
+    BasicBlock* block = &function->blocks[loop->blocks[b]];
+    for (int s = 0; s < block->successor_count; s++) {
+      if (!in_loop[block->successors[s]]) {
+        exits[exit_count++] = loop->blocks[b];
+        break;
+      }
+    }
+  }
+
+  int loop_size = 0;
+  for (int b = 0; b < loop->block_count; b++) {
+    loop_size += function->blocks[loop->blocks[b]].last - function->blocks[loop->blocks[b]].first;
+  }
+  Preheader preheader = {
+    .header = header->first,
+    .label = NO_STRING,
+    .hoisted = make_array(loop_size, sizeof(int)),
+    .hoisted_count = 0,
+    .first_reduction = pass->reduction_count,
+    .reduction_count = 0,
+  };
+
+  // Until nothing changes, hoisting a value can make the ones computed from it invariant too
+  int changed = 1;
+  while (changed) {
+    changed = 0;
+    for (int b = 0; b < loop->block_count; b++) {
+      BasicBlock* block = &function->blocks[loop->blocks[b]];
+      int always_runs = 1;
+      for (int e = 0; e < exit_count && always_runs; e++) {
+        always_runs = dominates(function, loop->blocks[b], exits[e]);
+      }
+
+      for (int i = block->first; i < block->last; i++) {
+        IC* instruction = &pass->code->instructions[i].instruction;
+        TemporarySet live_in = live->live_in[loop->header];
+        if (pass->moved[i] || !can_hoist(pass, instruction, has_call, has_check, always_runs, live_in)) {
+          continue;
+        }
+        pass->moved[i] = 1;
+        pass->invariant_stamp[*ic_definition(instruction)] = pass->stamp;
+        preheader.hoisted[preheader.hoisted_count++] = i;
+        invariants_hoisted++;
+        changed = 1;
+      }
+    }
+  }
+
+  for (int b = 0; b < loop->block_count; b++) {
+    BasicBlock* block = &function->blocks[loop->blocks[b]];
+    for (int i = block->first; i < block->last; i++) {
+      if (!pass->moved[i] && MATCHES(pass->code->instructions[i].instruction, ICBinOp)) {
+        reduce_multiplication(pass, function, &preheader, i, has_call);
+      }
+    }
+  }
+
+  if (preheader.hoisted_count == 0 && preheader.reduction_count == 0) {
+    return;
+  }
+
+  // Jumps into the loop from outside now go through the preheader
+  Label target = header_instruction->label;
+  for (int p = 0; p < header->predecessor_count; p++) {
+    BasicBlock* predecessor = &function->blocks[header->predecessors[p]];
+    if (in_loop[header->predecessors[p]] || predecessor->last == predecessor->first) {
+      continue;
+    }
+    match(pass->code->instructions[predecessor->last - 1].instruction) {
+      of(ICJump, label) {
+        if (*label == target) {
+          preheader.label = preheader.label == NO_STRING ? next_label() : preheader.label;
+          *label = preheader.label;
+        }
+      }
+      of(ICJumpIfFalse, _, label) {
+        if (*label == target) {
+          preheader.label = preheader.label == NO_STRING ? next_label() : preheader.label;
+          *label = preheader.label;
+        }
+      }
+      otherwise { }
+    }
+  }
+
+  pass->preheaders[pass->preheader_count++] = preheader;
+}
+
+static void append_preheader(IntermediaryCode* result, LoopPass* pass, Preheader* preheader) {
+  int first = result->size;
+  for (int h = 0; h < preheader->hoisted_count; h++) {
+    append_ic(result, pass->code->instructions[preheader->hoisted[h]].instruction);
+  }
+  for (int r = preheader->first_reduction; r < preheader->first_reduction + preheader->reduction_count; r++) {
+    Reduction* reduction = &pass->reductions[r];
+    if (!is_literal(reduction->step)) {
+      append_ic(result, ICBinOp(MultiplicationOperator(), reduction->step, reduction->increment, reduction->factor));
+    }
+    append_ic(result, ICBinOp(MultiplicationOperator(), reduction->reduced, reduction->variable, reduction->factor));
+  }
+  result->instructions[first].label = preheader->label;
+}
+
+// Returns whether anything changed
+static int optimize_loops_once(IntermediaryCode* code) {
+  CFG* cfg = make_cfg(code);
+  uint32_t size = interned_count();
+  LoopPass pass = {
+    .code = code,
+    .liveness = analyze_liveness(code, cfg),
+    .size = size,
+    .definitions = make_array(size, sizeof(int)),
+    .loop_stamp = make_array(size, sizeof(int)),
+    .loop_definitions = make_array(size, sizeof(int)),
+    .defined_at = make_array(size, sizeof(int)),
+    .invariant_stamp = make_array(size, sizeof(int)),
+    .stamp = 0,
+    .moved = make_array(code->size, sizeof(char)),
+    .first_update = make_array(code->size, sizeof(int)),
+    .preheader_count = 0,
+    .reductions = NULL,
+    .reduction_count = 0,
+    .reduction_capacity = 0,
+  };
+  memset(pass.first_update, 0xff, code->size * sizeof(int));
+  int loop_count = 0;
+  for (int f = 0; f < cfg->function_count; f++) {
+    loop_count += cfg->functions[f].loop_count;
+  }
+  pass.preheaders = make_array(loop_count, sizeof(Preheader));
+
+  for (int f = 0; f < cfg->function_count; f++) {
+    FunctionCFG* function = &cfg->functions[f];
+    for (int i = function->begin; i < function->end; i++) {
+      Storage* definition = ic_definition(&code->instructions[i].instruction);
+      if (definition != NULL) {
+        pass.definitions[*definition] = 0;
+      }
+    }
+    for (int i = function->begin; i < function->end; i++) {
+      Storage* definition = ic_definition(&code->instructions[i].instruction);
+      if (definition != NULL) {
+        pass.definitions[*definition]++;
+      }
+    }
+
+    // Inner loops first, what they hoist stays inside the enclosing loop until the next pass
+    for (int l = function->loop_count - 1; l >= 0; l--) {
+      optimize_loop(&pass, function, &function->loops[l], &pass.liveness->functions[f]);
+    }
+  }
+
+  if (pass.preheader_count == 0) {
+    return 0;
+  }
+
+  int* preheader_at = make_array(code->size, sizeof(int)); // Index into pass.preheaders plus one
+  for (int p = 0; p < pass.preheader_count; p++) {
+    preheader_at[pass.preheaders[p].header] = p + 1;
+  }
+
+  IntermediaryCode* result = arena_alloc(&intermediary_code_arena, sizeof(IntermediaryCode));
+  *result = (IntermediaryCode) { .instructions = NULL, .size = 0, .capacity = 0 };
+  for (int i = 0; i < code->size; i++) {
+    if (preheader_at[i] != 0) {
+      append_preheader(result, &pass, &pass.preheaders[preheader_at[i] - 1]);
+    }
+    if (pass.moved[i]) {
+      if (code->instructions[i].label != NO_STRING) {
+        append_label(result, code->instructions[i].label);
+      }
+      continue;
+    }
+
+    append_ic(result, code->instructions[i].instruction);
+    result->instructions[result->size - 1].label = code->instructions[i].label;
+    for (int r = pass.first_update[i]; r != -1; r = pass.reductions[r].next) {
+      Reduction* reduction = &pass.reductions[r];
+      append_ic(result, ICBinOp(reduction->update, reduction->reduced, reduction->reduced, reduction->step));
+    }
+  }
+  *code = *result;
+  return 1;
+}
+
+void optimize_loops(IntermediaryCode* code) {
+  // Each pass moves code out of one more level of nesting, deeper than this is rare
+  for (int pass = 0; pass < 4 && optimize_loops_once(code); pass++) {
+  }
+  remove_noops(code);
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#ifndef OPTIMIZATIONS_H
+#define OPTIMIZATIONS_H
+
+#include "intermediary-code.h"
+#include "ssa.h"
+
+#include <stdio.h>
+
+extern int calls_inlined;
+extern int functions_removed;
+extern int dead_instructions_removed;
+extern int prints_fused;
+extern int globals_promoted;
+extern int constants_propagated;
+extern int copies_propagated;
+extern int redundancies_removed;
+extern int invariants_hoisted;
+extern int multiplications_reduced;
+extern int bounds_checks_removed;
+
+// Value of an int or char literal. Fails for anything else
+int literal_value(Storage storage, int* value);
+Storage make_literal(int value);
+// Same results as the instructions asm.c emits for each operator, arithmetic wraps around at 32 bits. Fails when the
+// operation would trap
+int evaluate(BinaryOperator operator, int left, int right, int* result);
+
+// -O1: evaluates operations and conversions on literals, applies algebraic identities and resolves branches and bounds
+// checks on constants
+void fold_constants(IntermediaryCode* code);
+
+// -O1: replaces calls to small functions with a copy of their body, `limit` is the size (in IC instructions) up to
+// which a function is small. Every call site gets a line on `report`, unless it's NULL
+void inline_functions(IntermediaryCode* code, int limit, FILE* report);
+
+// -O1: drops the functions main never reaches, unreachable blocks, stores nobody reads and the global declarations
+// the code no longer mentions
+void eliminate_dead_code(IntermediaryCode* code, Program* program);
+
+// -O1: turns runs of prints of string constants into a single print of their concatenation
+void fuse_prints(IntermediaryCode* code);
+
+// -O2: globals that nothing a function calls can touch are kept in locals while it runs, loaded on entry and stored
+// back on the way out
+void promote_globals(IntermediaryCode* code);
+
+// -O2: sparse conditional constant propagation. Locals that only ever hold one value, counting just the branches that
+// can be taken, are replaced by it
+void propagate_constants(IntermediaryCode* code, SSA* ssa);
+
+// -O2: global value numbering over the dominator tree, which also propagates copies. Computations and loads already
+// available in a dominating block are reused
+void number_values(IntermediaryCode* code, SSA* ssa);
+
+// -O2: computations that give the same result on every iteration move to a preheader before the loop, and
+// multiplications of an induction variable become additions that follow it
+void optimize_loops(IntermediaryCode* code);
+
+// -fbounds-check: puts an ICCheckBounds against the declared length before every array access
+void insert_bounds_checks(IntermediaryCode* code, Program* program);
+
+// -O2: drops the bounds checks whose index is known to be in range, from what the tests of the loops around them say
+// about their induction variables
+void eliminate_bounds_checks(IntermediaryCode* code);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include "optimizations.h"
+
+#include <string.h>
+
+int prints_fused = 0;
+
+static int is_hex_digit(char c) { return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'); }
+
+// Joining two escaped strings must not change what either of them means: a trailing backslash would escape the first
+// character of `right`, and octal or hex escapes would take its leading digits as their own
+static int can_join(const char* left, const char* right) {
+  int numeric_escape = 0;
+  for (const char* c = left; *c != '\0'; c++) {
+    if (*c == '\\') {
+      if (c[1] == '\0') {
+        return 0;
+      }
+      c++;
+      numeric_escape = *c == 'x' || (*c >= '0' && *c <= '7');
+    } else if (numeric_escape && !is_hex_digit(*c)) {
+      numeric_escape = 0;
+    }
+  }
+  return !numeric_escape || !is_hex_digit(right[0]);
+}
+
+static Storage print_source(ICInstruction* instruction) {
+  match(instruction->instruction) {
+    of(ICPrint, src) return *src;
+    otherwise return NO_STRING;
+  }
+  return NO_STRING;
+}
+
+void fuse_prints(IntermediaryCode* code) {
+  // Escaped text of each string constant. Any other operand prints the bytes it holds, so it is never joined
+  uint32_t count = interned_count();
+  const char** constant_text = arena_alloc(&intermediary_code_arena, count * sizeof(const char*));
+  memset(constant_text, 0, count * sizeof(const char*));
+  for (StringDeclarationList* list = string_constants; list != NULL; list = list->next) {
+    constant_text[list->identifier] = list->value;
+  }
+
+  for (int i = 0; i < code->size; i++) {
+    Storage first = print_source(&code->instructions[i]);
+    const char* text = first == NO_STRING ? NULL : constant_text[first];
+    if (text == NULL) {
+      continue;
+    }
+
+    // Run of constant prints that nothing can jump into the middle of
+    int end = i + 1;
+    size_t length = strlen(text);
+    const char* previous = text;
+    while (end < code->size && code->instructions[end].label == NO_STRING) {
+      Storage next = print_source(&code->instructions[end]);
+      const char* next_text = next == NO_STRING ? NULL : constant_text[next];
+      if (next_text == NULL || !can_join(previous, next_text)) {
+        break;
+      }
+      length += strlen(next_text);
+      previous = next_text;
+      end++;
+    }
+
+    if (end == i + 1) {
+      continue;
+    }
+
+    char* joined = arena_alloc(&intermediary_code_arena, length + 1);
+    size_t used = 0;
+    for (int j = i; j < end; j++) {
+      const char* part = constant_text[print_source(&code->instructions[j])];
+      memcpy(joined + used, part, strlen(part));
+      used += strlen(part);
+      if (j > i) {
+        code->instructions[j].instruction = ICNoop();
+        prints_fused++;
+      }
+    }
+    joined[used] = '\0';
+    code->instructions[i].instruction = ICPrint(string_constant(joined));
+    i = end - 1;
+  }
+
+  remove_noops(code);
+}
\ No newline at end of file
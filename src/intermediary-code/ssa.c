@@ -0,0 +1,470 @@
+#include "ssa.h"
+
+#include "liveness.h"
+
+#include <string.h>
+
+int phis_inserted = 0;
+
+static void* make_array(int count, size_t size) {
+  void* array = arena_alloc(&intermediary_code_arena, count * size);
+  memset(array, 0, count * size);
+  return array;
+}
+
+int predecessor_index(BasicBlock* block, int predecessor) {
+  for (int p = 0; p < block->predecessor_count; p++) {
+    if (block->predecessors[p] == predecessor) {
+      return p;
+    }
+  }
+  return -1;
+}
+
+// The entry block must not be a jump target, or there'd be no edge to carry the values a phi there starts with. Only
+// functions without parameters can start with a label, those get a noop in front of it
+static void separate_entries(IntermediaryCode* code) {
+  int needed = 0;
+  for (int i = 0; i + 1 < code->size; i++) {
+    ICInstruction* current = &code->instructions[i];
+    needed += MATCHES(current->instruction, ICFunctionBegin) && code->instructions[i + 1].label != NO_STRING;
+  }
+  if (needed == 0) {
+    return;
+  }
+
+  IntermediaryCode* result = arena_alloc(&intermediary_code_arena, sizeof(IntermediaryCode));
+  *result = (IntermediaryCode) { .instructions = NULL, .size = 0, .capacity = 0 };
+  for (int i = 0; i < code->size; i++) {
+    append_ic(result, code->instructions[i].instruction);
+    result->instructions[result->size - 1].label = code->instructions[i].label;
+    if (MATCHES(code->instructions[i].instruction, ICFunctionBegin) && code->instructions[i + 1].label != NO_STRING) {
+      append_ic(result, ICNoop());
+    }
+  }
+  *code = *result;
+}
+
+static void build_dominator_tree(FunctionCFG* function, FunctionSSA* ssa) {
+  ssa->child_count = make_array(function->block_count, sizeof(int));
+  ssa->children = make_array(function->block_count, sizeof(int*));
+  for (int b = 0; b < function->block_count; b++) {
+    int dominator = function->blocks[b].immediate_dominator;
+    if (dominator != -1) {
+      ssa->child_count[dominator]++;
+    }
+  }
+  for (int b = 0; b < function->block_count; b++) {
+    ssa->children[b] = make_array(ssa->child_count[b], sizeof(int));
+    ssa->child_count[b] = 0;
+  }
+  // Reverse postorder, so that children come in the same order as the code
+  for (int i = 0; i < function->reachable_count; i++) {
+    int b = function->reverse_postorder[i];
+    int dominator = function->blocks[b].immediate_dominator;
+    if (dominator != -1) {
+      ssa->children[dominator][ssa->child_count[dominator]++] = b;
+    }
+  }
+}
+
+typedef struct Frontiers {
+  int** blocks; // Per block
+  int* count;
+} Frontiers;
+
+// Cytron et al. through Cooper, Harvey and Kennedy: a join point is in the frontier of every block on the way up from
+// its predecessors to its immediate dominator
+static Frontiers find_frontiers(FunctionCFG* function) {
+  Frontiers frontiers = {
+    .blocks = make_array(function->block_count, sizeof(int*)),
+    .count = make_array(function->block_count, sizeof(int)),
+  };
+
+  // First pass counts (with repeats, so it's an upper bound), the second one fills. All the additions of one join point
+  // happen together, so checking the last one is enough to skip repeats
+  for (int pass = 0; pass < 2; pass++) {
+    for (int b = 0; b < function->block_count; b++) {
+      BasicBlock* block = &function->blocks[b];
+      if (block->predecessor_count < 2 || block->postorder == -1) {
+        continue;
+      }
+      for (int p = 0; p < block->predecessor_count; p++) {
+        int runner = block->predecessors[p];
+        if (function->blocks[runner].postorder == -1) {
+          continue;
+        }
+        while (runner != block->immediate_dominator) {
+          int count = frontiers.count[runner];
+          if (pass == 0 || count == 0 || frontiers.blocks[runner][count - 1] != b) {
+            if (pass == 1) {
+              frontiers.blocks[runner][count] = b;
+            }
+            frontiers.count[runner]++;
+          }
+          runner = function->blocks[runner].immediate_dominator;
+        }
+      }
+    }
+
+    if (pass == 0) {
+      for (int b = 0; b < function->block_count; b++) {
+        frontiers.blocks[b] = make_array(frontiers.count[b], sizeof(int));
+        frontiers.count[b] = 0;
+      }
+    }
+  }
+
+  return frontiers;
+}
+
+static Phi* add_phi(FunctionCFG* function, FunctionSSA* ssa, int* capacity, int block, Storage variable) {
+  if (ssa->phi_count[block] == capacity[block]) {
+    int grown = capacity[block] == 0 ? 4 : capacity[block] * 2;
+    ssa->phis[block] = arena_realloc(
+        &intermediary_code_arena, ssa->phis[block], capacity[block] * sizeof(Phi), grown * sizeof(Phi)
+    );
+    capacity[block] = grown;
+  }
+
+  Phi* phi = &ssa->phis[block][ssa->phi_count[block]++];
+  int arguments = function->blocks[block].predecessor_count;
+  *phi = (Phi) { .result = variable, .variable = variable, .arguments = make_array(arguments, sizeof(Storage)) };
+  for (int p = 0; p < arguments; p++) {
+    phi->arguments[p] = variable;
+  }
+  phis_inserted++;
+  return phi;
+}
+
+static void place_phis(
+    IntermediaryCode* code, FunctionCFG* function, FunctionSSA* ssa, FunctionLiveness* live, Liveness* liveness
+) {
+  int block_count = function->block_count;
+  int variable_count = live->temporary_count;
+  Frontiers frontiers = find_frontiers(function);
+
+  // Blocks defining each variable, as linked lists threaded through `next_definition`
+  int definitions = 0;
+  for (int i = function->begin; i < function->end; i++) {
+    definitions += ic_definition(&code->instructions[i].instruction) != NULL;
+  }
+  int* first_definition = make_array(variable_count, sizeof(int));
+  int* next_definition = make_array(definitions, sizeof(int));
+  int* definition_block = make_array(definitions, sizeof(int));
+  memset(first_definition, 0xff, variable_count * sizeof(int));
+  int count = 0;
+  for (int b = 0; b < block_count; b++) {
+    for (int i = function->blocks[b].first; i < function->blocks[b].last; i++) {
+      Storage* definition = ic_definition(&code->instructions[i].instruction);
+      int index = definition == NULL ? -1 : temporary_index(liveness, *definition);
+      if (index != -1 && is_local_variable(*definition)) {
+        definition_block[count] = b;
+        next_definition[count] = first_definition[index];
+        first_definition[index] = count++;
+      }
+    }
+  }
+
+  ssa->phis = make_array(block_count, sizeof(Phi*));
+  ssa->phi_count = make_array(block_count, sizeof(int));
+  int* capacity = make_array(block_count, sizeof(int));
+
+  // Stamps instead of clearing a set per variable: `has_phi[b] == v + 1` when block b already has a phi for v
+  int* has_phi = make_array(block_count, sizeof(int));
+  int* queued = make_array(block_count, sizeof(int));
+  int* worklist = make_array(block_count, sizeof(int));
+
+  for (int v = 0; v < variable_count; v++) {
+    int pending = 0;
+    for (int d = first_definition[v]; d != -1; d = next_definition[d]) {
+      if (queued[definition_block[d]] != v + 1) {
+        queued[definition_block[d]] = v + 1;
+        worklist[pending++] = definition_block[d];
+      }
+    }
+
+    while (pending > 0) {
+      int b = worklist[--pending];
+      for (int f = 0; f < frontiers.count[b]; f++) {
+        int join = frontiers.blocks[b][f];
+        if (has_phi[join] == v + 1 || !SET_CONTAINS(live->live_in[join], v)) {
+          continue;
+        }
+        has_phi[join] = v + 1;
+        add_phi(function, ssa, capacity, join, live->temporaries[v]);
+        if (queued[join] != v + 1) {
+          queued[join] = v + 1;
+          worklist[pending++] = join;
+        }
+      }
+    }
+  }
+}
+
+static Storage new_version(Storage variable, Storage* current, int index, Storage* undo, int* undo_count) {
+  undo[(*undo_count)++] = index;
+  undo[(*undo_count)++] = current[index];
+  current[index] = copy_of_local(variable);
+  return current[index];
+}
+
+// Walks the dominator tree with the current version of each variable, undoing a block's versions once its subtree is
+// done
+static void rename_variables(
+    IntermediaryCode* code, FunctionCFG* function, FunctionSSA* ssa, FunctionLiveness* live, Liveness* liveness
+) {
+  Storage* current = make_array(live->temporary_count, sizeof(Storage));
+  for (int v = 0; v < live->temporary_count; v++) {
+    current[v] = live->temporaries[v];
+  }
+
+  // Pairs of (variable, previous version), at most one per definition
+  int definitions = 0;
+  for (int i = function->begin; i < function->end; i++) {
+    definitions += ic_definition(&code->instructions[i].instruction) != NULL;
+  }
+  for (int b = 0; b < function->block_count; b++) {
+    definitions += ssa->phi_count[b];
+  }
+  Storage* undo = make_array(2 * definitions, sizeof(Storage));
+  int undo_count = 0;
+
+  int* stack = make_array(function->block_count, sizeof(int));
+  int* next_child = make_array(function->block_count, sizeof(int));
+  int* undo_mark = make_array(function->block_count, sizeof(int));
+  int depth = 0;
+
+  stack[depth++] = 0;
+  while (depth > 0) {
+    int b = stack[depth - 1];
+    BasicBlock* block = &function->blocks[b];
+
+    if (next_child[b] == 0) {
+      undo_mark[b] = undo_count;
+
+      for (int p = 0; p < ssa->phi_count[b]; p++) {
+        Phi* phi = &ssa->phis[b][p];
+        phi->result = new_version(phi->variable, current, temporary_index(liveness, phi->variable), undo, &undo_count);
+      }
+
+      for (int i = block->first; i < block->last; i++) {
+        IC* instruction = &code->instructions[i].instruction;
+        Storage* uses[3];
+        int use_count = ic_uses(instruction, uses);
+        for (int u = 0; u < use_count; u++) {
+          int index = temporary_index(liveness, *uses[u]);
+          if (index != -1) {
+            *uses[u] = current[index];
+          }
+        }
+
+        Storage* definition = ic_definition(instruction);
+        int index = definition == NULL ? -1 : temporary_index(liveness, *definition);
+        if (index != -1 && is_local_variable(*definition)) {
+          *definition = new_version(*definition, current, index, undo, &undo_count);
+        }
+      }
+
+      for (int s = 0; s < block->successor_count; s++) {
+        BasicBlock* successor = &function->blocks[block->successors[s]];
+        int position = predecessor_index(successor, b);
+        for (int p = 0; p < ssa->phi_count[block->successors[s]]; p++) {
+          Phi* phi = &ssa->phis[block->successors[s]][p];
+          phi->arguments[position] = current[temporary_index(liveness, phi->variable)];
+        }
+      }
+    }
+
+    if (next_child[b] < ssa->child_count[b]) {
+      stack[depth++] = ssa->children[b][next_child[b]++];
+      continue;
+    }
+
+    while (undo_count > undo_mark[b]) {
+      undo_count -= 2;
+      current[undo[undo_count]] = undo[undo_count + 1];
+    }
+    depth--;
+  }
+}
+
+SSA* make_ssa(IntermediaryCode* code) {
+  separate_entries(code);
+
+  SSA* ssa = arena_alloc(&intermediary_code_arena, sizeof(SSA));
+  ssa->cfg = make_cfg(code);
+  ssa->functions = make_array(ssa->cfg->function_count, sizeof(FunctionSSA));
+  Liveness* liveness = analyze_liveness(code, ssa->cfg);
+
+  for (int f = 0; f < ssa->cfg->function_count; f++) {
+    FunctionCFG* function = &ssa->cfg->functions[f];
+    build_dominator_tree(function, &ssa->functions[f]);
+    place_phis(code, function, &ssa->functions[f], &liveness->functions[f], liveness);
+    rename_variables(code, function, &ssa->functions[f], &liveness->functions[f], liveness);
+  }
+
+  return ssa;
+}
+
+// Copies that all happen at once. They're ordered so that nothing is overwritten before it's read, and a cycle is
+// broken by saving one of its values in a temporary first
+static void append_parallel_copies(IntermediaryCode* result, Storage* destinations, Storage* sources, int count) {
+  int pending = 0;
+  for (int c = 0; c < count; c++) {
+    if (destinations[c] != sources[c]) {
+      destinations[pending] = destinations[c];
+      sources[pending++] = sources[c];
+    }
+  }
+
+  while (pending > 0) {
+    int ready = -1;
+    for (int c = 0; c < pending && ready == -1; c++) {
+      int read = 0;
+      for (int other = 0; other < pending && !read; other++) {
+        read = other != c && sources[other] == destinations[c];
+      }
+      if (!read) {
+        ready = c;
+      }
+    }
+
+    if (ready == -1) {
+      Storage saved = next_storage();
+      if (is_float(destinations[0])) {
+        mark_float(saved);
+      }
+      append_ic(result, ICCopy(saved, destinations[0]));
+      for (int c = 1; c < pending; c++) {
+        if (sources[c] == destinations[0]) {
+          sources[c] = saved;
+        }
+      }
+      ready = 0;
+    }
+
+    append_ic(result, ICCopy(destinations[ready], sources[ready]));
+    destinations[ready] = destinations[pending - 1];
+    sources[ready] = sources[pending - 1];
+    pending--;
+  }
+}
+
+static void append_edge_copies(IntermediaryCode* result, FunctionSSA* ssa, FunctionCFG* function, int from, int to) {
+  int position = predecessor_index(&function->blocks[to], from);
+  Storage destinations[ssa->phi_count[to] + 1];
+  Storage sources[ssa->phi_count[to] + 1];
+  int count = 0;
+  for (int p = 0; p < ssa->phi_count[to]; p++) {
+    Phi* phi = &ssa->phis[to][p];
+    if (phi->result != NO_STRING) {
+      destinations[count] = phi->result;
+      sources[count++] = phi->arguments[position];
+    }
+  }
+  append_parallel_copies(result, destinations, sources, count);
+}
+
+static int has_phis(FunctionSSA* ssa, int block) {
+  for (int p = 0; p < ssa->phi_count[block]; p++) {
+    if (ssa->phis[block][p].result != NO_STRING) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void copy_instruction(IntermediaryCode* result, ICInstruction* instruction) {
+  append_ic(result, instruction->instruction);
+  result->instructions[result->size - 1].label = instruction->label;
+}
+
+static void leave_function(IntermediaryCode* code, IntermediaryCode* result, FunctionCFG* function, FunctionSSA* ssa) {
+  // Edges from a conditional jump into a block with phis, their copies go after the rest of the function
+  int split_count = 0;
+  int* split_from = make_array(function->block_count, sizeof(int));
+  int* split_to = make_array(function->block_count, sizeof(int));
+  Label* split_label = make_array(function->block_count, sizeof(Label));
+  Label* split_target = make_array(function->block_count, sizeof(Label));
+
+  copy_instruction(result, &code->instructions[function->begin]);
+  for (int b = 0; b < function->block_count; b++) {
+    BasicBlock* block = &function->blocks[b];
+    ICInstruction* last = block->last > block->first ? &code->instructions[block->last - 1] : NULL;
+    int ends_with_jump = last != NULL && (MATCHES(last->instruction, ICJump) || MATCHES(last->instruction, ICReturn));
+    int ends_with_branch = last != NULL && MATCHES(last->instruction, ICJumpIfFalse);
+
+    for (int i = block->first; i < block->last - (ends_with_jump || ends_with_branch); i++) {
+      copy_instruction(result, &code->instructions[i]);
+    }
+
+    // Falling through is the true branch. The last block has nowhere to fall but the end of the function
+    int fallthrough = b + 1 < function->block_count ? b + 1 : -1;
+    int taken = ends_with_branch ? block->successors[block->successor_count - 1] : -1;
+
+    if (ends_with_branch && taken == fallthrough) {
+      // Both ways lead to the same block, so there's nothing to decide
+      append_ic(result, ICNoop());
+      result->instructions[result->size - 1].label = last->label;
+      append_edge_copies(result, ssa, function, b, taken);
+    } else if (ends_with_branch) {
+      ICInstruction branch = *last;
+      if (has_phis(ssa, taken)) {
+        split_from[split_count] = b;
+        split_to[split_count] = taken;
+        split_label[split_count] = next_label();
+        match(branch.instruction) {
+          of(ICJumpIfFalse, _, label) {
+            split_target[split_count] = *label;
+            *label = split_label[split_count];
+          }
+          otherwise { }
+        }
+        split_count++;
+      }
+      copy_instruction(result, &branch);
+      if (fallthrough != -1) {
+        append_edge_copies(result, ssa, function, b, fallthrough);
+      }
+    } else {
+      if (block->successor_count == 1) {
+        append_edge_copies(result, ssa, function, b, block->successors[0]);
+      }
+      if (ends_with_jump) {
+        copy_instruction(result, last);
+      }
+    }
+  }
+
+  ICInstruction end = code->instructions[function->end];
+  if (split_count > 0) {
+    // Nothing may fall into the split edges
+    IC* previous = &result->instructions[result->size - 1].instruction;
+    if (!MATCHES(*previous, ICJump) && !MATCHES(*previous, ICReturn)) {
+      if (end.label == NO_STRING) {
+        end.label = next_label();
+      }
+      append_ic(result, ICJump(end.label));
+    }
+
+    for (int s = 0; s < split_count; s++) {
+      append_label(result, split_label[s]);
+      append_edge_copies(result, ssa, function, split_from[s], split_to[s]);
+      append_ic(result, ICJump(split_target[s]));
+    }
+  }
+  copy_instruction(result, &end);
+}
+
+void leave_ssa(IntermediaryCode* code, SSA* ssa) {
+  IntermediaryCode* result = arena_alloc(&intermediary_code_arena, sizeof(IntermediaryCode));
+  *result = (IntermediaryCode) { .instructions = NULL, .size = 0, .capacity = 0 };
+
+  for (int f = 0; f < ssa->cfg->function_count; f++) {
+    leave_function(code, result, &ssa->cfg->functions[f], &ssa->functions[f]);
+  }
+
+  *code = *result;
+  remove_noops(code);
+}
\ No newline at end of file
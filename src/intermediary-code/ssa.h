@@ -0,0 +1,41 @@
+#ifndef SSA_H
+#define SSA_H
+
+#include "cfg.h"
+
+// Joins the versions of `variable` reaching a block, one argument per predecessor
+typedef struct Phi {
+  Storage result;     // NO_STRING once an optimization made the phi useless
+  Storage variable;   // The local variable it versions
+  Storage* arguments; // In the order of the block's predecessors
+} Phi;
+
+typedef struct FunctionSSA {
+  Phi** phis;     // Per block
+  int* phi_count; // Per block
+
+  // Dominator tree
+  int** children; // Per block
+  int* child_count;
+} FunctionSSA;
+
+// Every local variable definition gets a version of its own (`x.3`), so each local is written exactly once and its
+// definition dominates its uses. Temporaries already are. The phis live beside the code, which keeps the CFG valid as
+// long as no optimization touches the jumps
+typedef struct SSA {
+  CFG* cfg;
+  FunctionSSA* functions; // Same order as the CFG's
+} SSA;
+
+extern int phis_inserted;
+
+// Pruned SSA: phis only go where the variable is live. Lives in intermediary_code_arena
+SSA* make_ssa(IntermediaryCode* code);
+
+// Phis become copies on the incoming edges, critical edges get a block of their own
+void leave_ssa(IntermediaryCode* code, SSA* ssa);
+
+// Position of `predecessor` in the predecessors of `block`
+int predecessor_index(BasicBlock* block, int predecessor);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,321 @@
+#include "optimizations.h"
+
+#include <string.h>
+
+int copies_propagated = 0;
+int redundancies_removed = 0;
+
+// Kinds of keys besides the binary operators, which use their tag
+enum { LOAD_KEY = 64, ARRAY_KEY, CHECK_KEY, CONVERT_KEY };
+
+// What a value is computed from. Memory (globals and arrays) can change between two reads, so reading it also depends
+// on the epoch, which moves on with every write that could reach it
+typedef struct Key {
+  int kind;
+  Storage left;
+  Storage right;
+  int left_epoch;
+  int right_epoch;
+} Key;
+
+typedef struct Entry {
+  Key key;
+  Storage value; // NO_STRING for empty slots
+} Entry;
+
+// Open addressing, with every insertion logged so that leaving a block can take them back out in reverse order
+typedef struct ValueTable {
+  Entry* entries;
+  uint32_t mask;
+  int* inserted;
+  int inserted_count;
+} ValueTable;
+
+static void* make_array(int count, size_t size) {
+  void* array = arena_alloc(&intermediary_code_arena, count * size);
+  memset(array, 0, count * size);
+  return array;
+}
+
+static int same_key(Key* a, Key* b) {
+  return a->kind == b->kind && a->left == b->left && a->right == b->right && a->left_epoch == b->left_epoch &&
+         a->right_epoch == b->right_epoch;
+}
+
+// Slot holding `key`, or the empty one where it would go
+static uint32_t find_slot(ValueTable* table, Key* key) {
+  uint32_t hash = (uint32_t)key->kind * 0x9e3779b1u;
+  hash = (hash ^ key->left) * 0x85ebca6bu;
+  hash = (hash ^ key->right) * 0xc2b2ae35u;
+  hash = (hash ^ (uint32_t)key->left_epoch) * 0x27d4eb2fu;
+  hash = (hash ^ (uint32_t)key->right_epoch) * 0x165667b1u;
+  uint32_t slot = (hash ^ (hash >> 15)) & table->mask;
+  while (table->entries[slot].value != NO_STRING && !same_key(&table->entries[slot].key, key)) {
+    slot = (slot + 1) & table->mask;
+  }
+  return slot;
+}
+
+static Storage lookup(ValueTable* table, Key key) { return table->entries[find_slot(table, &key)].value; }
+
+static void insert(ValueTable* table, Key key, Storage value) {
+  uint32_t slot = find_slot(table, &key);
+  if (table->entries[slot].value == NO_STRING) {
+    table->entries[slot] = (Entry) { key, value };
+    table->inserted[table->inserted_count++] = slot;
+  }
+}
+
+// Linear probing can't just empty a slot, the entries after it would become unreachable. Taking them out in the reverse
+// order they went in works, every entry in between was inserted later and is already gone
+static void remove_since(ValueTable* table, int mark) {
+  while (table->inserted_count > mark) {
+    table->entries[table->inserted[--table->inserted_count]].value = NO_STRING;
+  }
+}
+
+typedef struct Numbering {
+  Storage* leader; // Indexed by StringId: what replaces each local whose definition was dropped, NO_STRING otherwise
+  uint32_t size;
+  int epoch;      // Of the block being visited
+  int last_epoch; // Highest one handed out
+} Numbering;
+
+static Storage leader_of(Numbering* numbering, Storage storage) {
+  while (storage < numbering->size && numbering->leader[storage] != NO_STRING) {
+    storage = numbering->leader[storage];
+  }
+  return storage;
+}
+
+static int is_global(Storage storage) { return !is_local(storage) && !is_literal(storage); }
+
+static int epoch_of(Numbering* numbering, Storage storage) { return is_global(storage) ? numbering->epoch : 0; }
+
+static void write_memory(Numbering* numbering) { numbering->epoch = ++numbering->last_epoch; }
+
+static int is_commutative(BinaryOperator operator) {
+  return MATCHES(operator, SumOperator) || MATCHES(operator, MultiplicationOperator) ||
+         MATCHES(operator, AndOperator) || MATCHES(operator, OrOperator) || MATCHES(operator, NotOperator) ||
+         MATCHES(operator, EqualsOperator) || MATCHES(operator, DiffersOperator);
+}
+
+static Key binary_key(Numbering* numbering, BinaryOperator operator, Storage left, Storage right) {
+  Key key = { operator.tag, left, right, epoch_of(numbering, left), epoch_of(numbering, right) };
+  int swapped = key.left > key.right || (key.left == key.right && key.left_epoch > key.right_epoch);
+  if (is_commutative(operator) && swapped) {
+    key = (Key) { key.kind, key.right, key.left, key.right_epoch, key.left_epoch };
+  }
+  return key;
+}
+
+// The definition of `dst` is redundant, from now on `value` stands for it
+static void replace_definition(Numbering* numbering, ICInstruction* instruction, Storage dst, Storage value) {
+  numbering->leader[dst] = value;
+  instruction->instruction = ICNoop();
+}
+
+static void number_instruction(Numbering* numbering, ValueTable* table, ICInstruction* current) {
+  IC* instruction = &current->instruction;
+  Storage* uses[3];
+  int use_count = ic_uses(instruction, uses);
+  for (int u = 0; u < use_count; u++) {
+    *uses[u] = leader_of(numbering, *uses[u]);
+  }
+
+  match(*instruction) {
+    of(ICCopy, dst, src) {
+      Storage source = *src;
+      if (is_local(*dst) && !is_global(source)) {
+        replace_definition(numbering, current, *dst, source);
+        copies_propagated++;
+      } else if (is_local(*dst)) {
+        Key key = { LOAD_KEY, source, NO_STRING, numbering->epoch, 0 };
+        Storage loaded = lookup(table, key);
+        if (loaded != NO_STRING) {
+          replace_definition(numbering, current, *dst, loaded);
+          redundancies_removed++;
+        } else {
+          insert(table, key, *dst);
+        }
+      } else {
+        // A store, reading the global right after gives back what was stored
+        Storage global = *dst;
+        write_memory(numbering);
+        if (!is_global(source)) {
+          insert(table, (Key) { LOAD_KEY, global, NO_STRING, numbering->epoch, 0 }, source);
+        }
+      }
+    }
+    of(ICBinOp, operator, dst, left, right) {
+      if (is_local(*dst)) {
+        Key key = binary_key(numbering, *operator, *left, *right);
+        Storage computed = lookup(table, key);
+        if (computed != NO_STRING) {
+          replace_definition(numbering, current, *dst, computed);
+          redundancies_removed++;
+        } else {
+          insert(table, key, *dst);
+        }
+      } else {
+        write_memory(numbering);
+      }
+    }
+    of(ICConvert, dst, src) {
+      if (is_local(*dst)) {
+        Key key = { CONVERT_KEY, *src, NO_STRING, epoch_of(numbering, *src), 0 };
+        Storage converted = lookup(table, key);
+        if (converted != NO_STRING) {
+          replace_definition(numbering, current, *dst, converted);
+          redundancies_removed++;
+        } else {
+          insert(table, key, *dst);
+        }
+      } else {
+        write_memory(numbering);
+      }
+    }
+    of(ICCopyFrom, dst, array, index) {
+      if (is_local(*dst)) {
+        Key key = { ARRAY_KEY, *array, *index, numbering->epoch, 0 };
+        Storage loaded = lookup(table, key);
+        if (loaded != NO_STRING) {
+          replace_definition(numbering, current, *dst, loaded);
+          redundancies_removed++;
+        } else {
+          insert(table, key, *dst);
+        }
+      } else {
+        write_memory(numbering);
+      }
+    }
+    // The same index checked against the same length in a dominating block already stopped the program if it was out
+    // of range. A global index only counts as the same until memory is written
+    of(ICCheckBounds, index, length) {
+      Key key = { CHECK_KEY, *index, (Storage)*length, epoch_of(numbering, *index), 0 };
+      if (lookup(table, key) != NO_STRING) {
+        current->instruction = ICNoop();
+        redundancies_removed++;
+      } else {
+        insert(table, key, *index);
+      }
+    }
+    of(ICCopyAt, _, _, _) write_memory(numbering);
+    of(ICCall, _, _) write_memory(numbering);
+    of(ICInput, _, dst) {
+      if (!is_local(*dst)) {
+        write_memory(numbering);
+      }
+    }
+    otherwise { }
+  }
+}
+
+// A phi whose arguments all end up being the same value is that value
+static void number_phis(Numbering* numbering, FunctionCFG* function, FunctionSSA* ssa, int b) {
+  for (int p = 0; p < ssa->phi_count[b]; p++) {
+    Phi* phi = &ssa->phis[b][p];
+    if (phi->result == NO_STRING) {
+      continue;
+    }
+
+    Storage same = NO_STRING;
+    int trivial = 1;
+    for (int a = 0; a < function->blocks[b].predecessor_count && trivial; a++) {
+      Storage argument = leader_of(numbering, phi->arguments[a]);
+      if (argument == phi->result || argument == same) {
+        continue;
+      }
+      trivial = same == NO_STRING;
+      same = argument;
+    }
+    if (trivial && same != NO_STRING) {
+      numbering->leader[phi->result] = same;
+      phi->result = NO_STRING;
+      copies_propagated++;
+    }
+  }
+}
+
+// Preorder over the dominator tree, so the table holds exactly the values of the dominating blocks
+static void number_function(IntermediaryCode* code, Numbering* numbering, FunctionCFG* function, FunctionSSA* ssa) {
+  int size = function->end - function->begin;
+  uint32_t capacity = 16;
+  while (capacity < 2 * (uint32_t)size) {
+    capacity *= 2;
+  }
+  ValueTable table = {
+    .entries = make_array(capacity, sizeof(Entry)),
+    .mask = capacity - 1,
+    .inserted = make_array(size, sizeof(int)),
+    .inserted_count = 0,
+  };
+  for (uint32_t s = 0; s < capacity; s++) {
+    table.entries[s].value = NO_STRING;
+  }
+
+  int* stack = make_array(function->block_count, sizeof(int));
+  int* next_child = make_array(function->block_count, sizeof(int));
+  int* table_mark = make_array(function->block_count, sizeof(int));
+  int* end_epoch = make_array(function->block_count, sizeof(int));
+  int depth = 0;
+
+  stack[depth++] = 0;
+  while (depth > 0) {
+    int b = stack[depth - 1];
+    BasicBlock* block = &function->blocks[b];
+
+    if (next_child[b] == 0) {
+      table_mark[b] = table.inserted_count;
+      // Memory is only known to be unchanged on entry when the dominator is the one way in
+      int dominator = block->immediate_dominator;
+      if (dominator != -1 && block->predecessor_count == 1 && block->predecessors[0] == dominator) {
+        numbering->epoch = end_epoch[dominator];
+      } else {
+        write_memory(numbering);
+      }
+
+      number_phis(numbering, function, ssa, b);
+      for (int i = block->first; i < block->last; i++) {
+        number_instruction(numbering, &table, &code->instructions[i]);
+      }
+      end_epoch[b] = numbering->epoch;
+    }
+
+    if (next_child[b] < ssa->child_count[b]) {
+      stack[depth++] = ssa->children[b][next_child[b]++];
+      continue;
+    }
+
+    remove_since(&table, table_mark[b]);
+    depth--;
+  }
+
+  // Uses the walk hadn't reached yet: phi arguments coming through back edges, and code no path reaches
+  for (int i = function->begin; i < function->end; i++) {
+    Storage* uses[3];
+    int use_count = ic_uses(&code->instructions[i].instruction, uses);
+    for (int u = 0; u < use_count; u++) {
+      *uses[u] = leader_of(numbering, *uses[u]);
+    }
+  }
+  for (int b = 0; b < function->block_count; b++) {
+    for (int p = 0; p < ssa->phi_count[b]; p++) {
+      for (int a = 0; a < function->blocks[b].predecessor_count; a++) {
+        ssa->phis[b][p].arguments[a] = leader_of(numbering, ssa->phis[b][p].arguments[a]);
+      }
+    }
+  }
+}
+
+void number_values(IntermediaryCode* code, SSA* ssa) {
+  Numbering numbering = { .size = interned_count(), .epoch = 0, .last_epoch = 0 };
+  numbering.leader = make_array(numbering.size, sizeof(Storage));
+  for (uint32_t s = 0; s < numbering.size; s++) {
+    numbering.leader[s] = NO_STRING;
+  }
+
+  for (int f = 0; f < ssa->cfg->function_count; f++) {
+    number_function(code, &numbering, &ssa->cfg->functions[f], &ssa->functions[f]);
+  }
+}
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include "interner.h"
+
+#include <string.h>
+
+Arena string_arena = { .name = "strings" };
+
+static char** strings = NULL;
+static uint32_t string_count = 0;
+static uint32_t string_capacity = 0;
+
+// Open addressing, 0 marks an empty slot
+static StringId* slots = NULL;
+static uint32_t slot_count = 0;
+
+static uint32_t hash(const char* string) {
+  // FNV-1a
+  uint32_t hash = 2166136261u;
+  while (*string != '\0') {
+    hash ^= (unsigned char)*string;
+    hash *= 16777619u;
+    string++;
+  }
+  return hash;
+}
+
+static void grow_slots() {
+  slot_count = slot_count == 0 ? 1024 : slot_count * 2;
+  slots = arena_alloc(&string_arena, slot_count * sizeof(StringId));
+  memset(slots, 0, slot_count * sizeof(StringId));
+
+  for (StringId id = 1; id < string_count; id++) {
+    uint32_t slot = hash(strings[id]) & (slot_count - 1);
+    while (slots[slot] != NO_STRING) {
+      slot = (slot + 1) & (slot_count - 1);
+    }
+    slots[slot] = id;
+  }
+}
+
+StringId intern(const char* string) {
+  if (string_count == 0) {
+    // Reserve the id for NO_STRING
+    string_capacity = 1024;
+    strings = arena_alloc(&string_arena, string_capacity * sizeof(char*));
+    strings[NO_STRING] = "";
+    string_count = 1;
+  }
+
+  // Keep the load factor under one half
+  if (string_count * 2 >= slot_count) {
+    grow_slots();
+  }
+
+  uint32_t slot = hash(string) & (slot_count - 1);
+  while (slots[slot] != NO_STRING) {
+    if (strcmp(strings[slots[slot]], string) == 0) {
+      return slots[slot];
+    }
+    slot = (slot + 1) & (slot_count - 1);
+  }
+
+  if (string_count == string_capacity) {
+    strings =
+        arena_realloc(&string_arena, strings, string_capacity * sizeof(char*), 2 * string_capacity * sizeof(char*));
+    string_capacity *= 2;
+  }
+
+  StringId id = string_count++;
+  strings[id] = arena_strdup(&string_arena, string);
+  slots[slot] = id;
+  return id;
+}
+
+const char* string_of(StringId id) { return strings[id]; }
+
+uint32_t interned_count() { return string_count == 0 ? 1 : string_count; }
+
+void free_interned_strings() {
+  arena_free(&string_arena);
+  strings = NULL;
+  string_count = 0;
+  string_capacity = 0;
+  slots = NULL;
+  slot_count = 0;
+}
\ No newline at end of file
@@ -0,0 +1,26 @@
+#ifndef INTERNER_H
+#define INTERNER_H
+
+#include "arena.h"
+
+#include <stdint.h>
+
+// Handle to an interned string. Equal strings always get the same handle, so comparing them is an integer compare
+typedef uint32_t StringId;
+
+// Never returned by intern, stands for "no string"
+#define NO_STRING 0
+
+StringId intern(const char* string);
+const char* string_of(StringId id);
+
+// Every handle given out so far is smaller than this, handy to size arrays indexed by StringId
+uint32_t interned_count();
+
+// Interned strings and string literals
+extern Arena string_arena;
+
+// Invalidates every StringId given out so far
+void free_interned_strings();
+
+#endif
\ No newline at end of file
@@ -10,6 +10,9 @@
   int yyerror(char* s);
 
   extern Program yyprogram;
+
+  // Lists are right recursive, so big programs need a deep parser stack
+  #define YYMAXDEPTH 10000000
 %}
 
 %union {
@@ -1,16 +1,22 @@
 #include "syntax-tree.h"
 
-#include <stdlib.h>
+Arena syntax_tree_arena = { .name = "syntax tree" };
+int syntax_tree_node_count = 0;
+
+static void* make_node(size_t size) {
+  syntax_tree_node_count++;
+  return arena_alloc(&syntax_tree_arena, size);
+}
 
 DeclarationList* make_declaration(Declaration declaration) {
-  DeclarationList* dec = malloc(sizeof(DeclarationList));
+  DeclarationList* dec = make_node(sizeof(DeclarationList));
   dec->declaration = declaration;
   dec->next = NULL;
   return dec;
 }
 
 ParametersDeclaration* make_parameters_declaration(Type type, Identifier name) {
-  ParametersDeclaration* dec = malloc(sizeof(ParametersDeclaration));
+  ParametersDeclaration* dec = make_node(sizeof(ParametersDeclaration));
   dec->type = type;
   dec->name = name;
   dec->next = NULL;
@@ -18,41 +24,41 @@ ParametersDeclaration* make_parameters_declaration(Type type, Identifier name) {
 }
 
 ArrayInitialization* make_array_initialization(Literal value) {
-  ArrayInitialization* init = malloc(sizeof(ArrayInitialization));
+  ArrayInitialization* init = make_node(sizeof(ArrayInitialization));
   init->value = value;
   init->next = NULL;
   return init;
 }
 
 StatementList* make_statement_list(Statement statement) {
-  StatementList* init = malloc(sizeof(StatementList));
+  StatementList* init = make_node(sizeof(StatementList));
   init->statement = statement;
   init->next = NULL;
   return init;
 }
 
 ArgumentList* make_argument_list(Expression argument) {
-  ArgumentList* list = malloc(sizeof(ArgumentList));
+  ArgumentList* list = make_node(sizeof(ArgumentList));
   list->argument = argument;
   list->next = NULL;
   return list;
 }
 
 ImplementationList* make_implementation_list(Implementation implementation) {
-  ImplementationList* list = malloc(sizeof(ImplementationList));
+  ImplementationList* list = make_node(sizeof(ImplementationList));
   list->implementation = implementation;
   list->next = NULL;
   return list;
 }
 
 Expression* make_expression(Expression expression) {
-  Expression* alloc = malloc(sizeof(Expression));
+  Expression* alloc = make_node(sizeof(Expression));
   *alloc = expression;
   return alloc;
 }
 
 Statement* make_statement(Statement statement) {
-  Statement* alloc = malloc(sizeof(Statement));
+  Statement* alloc = make_node(sizeof(Statement));
   *alloc = statement;
   return alloc;
 }
\ No newline at end of file
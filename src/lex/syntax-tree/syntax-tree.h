@@ -1,9 +1,12 @@
 #ifndef SYNTAX_TREE_H
 #define SYNTAX_TREE_H
 
+#include "arena.h"
+#include "interner.h"
+
 #include <datatype99.h>
 
-typedef char* Identifier;
+typedef StringId Identifier;
 
 datatype(Type, (IntegerType), (FloatType), (CharType));
 
@@ -80,6 +83,9 @@ typedef struct Program {
   ImplementationList* implementations;
 } Program;
 
+extern Arena syntax_tree_arena;
+extern int syntax_tree_node_count;
+
 DeclarationList* make_declaration(Declaration declaration);
 ParametersDeclaration* make_parameters_declaration(Type type, Identifier name);
 ArrayInitialization* make_array_initialization(Literal value);
@@ -1,12 +1,17 @@
 #include "asm.h"
+#include "cfg.h"
 #include "format.h"
 #include "intermediary-code.h"
+#include "optimizations.h"
 #include "semantic-check.h"
+#include "symbol-table.h"
 #include "syntax-tree.h"
+#include "time-report.h"
 #include "y.tab.h"
 
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 extern int yyparse(void);
@@ -16,23 +21,71 @@ extern int has_error;
 
 Program yyprogram;
 
+static void print_stats(SymbolTable* symbols) {
+  fprintf(stderr, "interned strings: %u\n", interned_count());
+  print_arena_stats(stderr, &string_arena);
+  print_arena_stats(stderr, &syntax_tree_arena);
+  print_arena_stats(stderr, &symbols->arena);
+  print_arena_stats(stderr, &semantic_check_arena);
+  print_arena_stats(stderr, &intermediary_code_arena);
+  print_arena_stats(stderr, &asm_arena);
+}
+
 int main(int argc, char** argv) {
-  if (argc < 2) {
+  char* input = NULL;
+  int stats = 0;
+  int time_report = 0;
+  int optimization_level = 0;
+  int dump_cfg = 0;
+  int inline_limit = -1;
+  int inline_report = 0;
+  int bounds_check = 0;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--stats") == 0) {
+      stats = 1;
+    } else if (strcmp(argv[i], "--time-report") == 0) {
+      time_report = 1;
+    } else if (strcmp(argv[i], "--time-report=json") == 0) {
+      time_report = 2;
+    } else if (strcmp(argv[i], "--dump-cfg") == 0) {
+      dump_cfg = 1;
+    } else if (strncmp(argv[i], "-finline-limit=", 15) == 0) {
+      inline_limit = atoi(argv[i] + 15);
+    } else if (strcmp(argv[i], "--inline-report") == 0) {
+      inline_report = 1;
+    } else if (strcmp(argv[i], "-fbounds-check") == 0) {
+      bounds_check = 1;
+    } else if (strcmp(argv[i], "-O0") == 0) {
+      optimization_level = 0;
+    } else if (strcmp(argv[i], "-O1") == 0) {
+      optimization_level = 1;
+    } else if (strcmp(argv[i], "-O2") == 0) {
+      optimization_level = 2;
+    } else {
+      input = argv[i];
+    }
+  }
+
+  if (input == NULL) {
     return 1;
   }
 
-  yyin = fopen(argv[1], "r");
+  yyin = fopen(input, "r");
   if (yyin == NULL) {
-    fprintf(stderr, "error: could not open input file \"%s\": %s", argv[1], strerror(errno));
+    fprintf(stderr, "error: could not open input file \"%s\": %s", input, strerror(errno));
     return 1;
   }
 
   // Parse and check for error
+  start_phase("lexing/parsing");
   if (yyparse()) {
     return 3;
   }
 
-  SemanticErrorList* list = verify_program(yyprogram);
+  start_phase("semantic check");
+  SymbolTable* symbols = make_symbol_table();
+  SemanticErrorList* list = verify_program(yyprogram, symbols);
+  end_phase();
   if (list != NULL) {
     while (list != NULL) {
       fprintf(stderr, "warning: %s\n", list->error.message);
@@ -45,8 +98,101 @@ int main(int argc, char** argv) {
     return 3;
   }
 
-  FILE* out = fopen("out.s", "w+");
-  write_asm(yyprogram, out);
+  start_phase("IC generation");
+  IntermediaryCode* ic = intemediary_code_from_program(yyprogram, symbols);
+  if (bounds_check) {
+    insert_bounds_checks(ic, &yyprogram);
+  }
+
+  if (optimization_level >= 1) {
+    start_phase("IC optimization");
+    inline_functions(ic, inline_limit == -1 ? 20 : inline_limit, inline_report ? stderr : NULL);
+    fold_constants(ic);
+    eliminate_dead_code(ic, &yyprogram);
+  }
+
+  if (optimization_level >= 2) {
+    start_phase("SSA optimization");
+    promote_globals(ic);
+    SSA* ssa = make_ssa(ic);
+    propagate_constants(ic, ssa);
+    number_values(ic, ssa);
+    leave_ssa(ic, ssa);
+    eliminate_bounds_checks(ic);
+    optimize_loops(ic);
+    // Branches on the constants found are only resolved here, and what they leave behind is dead
+    fold_constants(ic);
+    eliminate_dead_code(ic, &yyprogram);
+  }
+
+  if (optimization_level >= 1) {
+    fuse_prints(ic);
+  }
+
+  // Graphviz on stdout, e.g. `compilerProject --dump-cfg input.lang | dot -Tsvg > cfg.svg`
+  if (dump_cfg) {
+    start_phase("CFG dump");
+    print_cfg(stdout, ic, make_cfg(ic));
+  }
+
+  // Without optimizations temporaries still share .data slots, they just never get a register
+  start_phase("register allocation");
+  RegisterAllocation* allocation = allocate_registers(ic, optimization_level >= 1);
+
+  start_phase("asm emission");
+  AsmCode* text = make_asm(ic, allocation);
+
+  start_phase("file write");
+  Output* out = open_output("out.s");
+  if (out == NULL) {
+    fprintf(stderr, "error: could not open output file \"out.s\": %s", strerror(errno));
+    return 1;
+  }
+  write_asm(yyprogram, text, out);
+  if (close_output(out) == -1) {
+    fprintf(stderr, "error: could not write output file \"out.s\": %s", strerror(errno));
+    return 1;
+  }
+  end_phase();
+
+  if (stats) {
+    print_stats(symbols);
+  }
+
+  if (time_report) {
+    report_counter("AST nodes", syntax_tree_node_count);
+    report_counter("IC instructions", ic->size);
+    report_counter("temporaries", temporary_count);
+    report_counter("string constants", string_constant_count);
+    report_counter("calls inlined", calls_inlined);
+    report_counter("functions removed", functions_removed);
+    report_counter("dead instructions", dead_instructions_removed);
+    report_counter("prints fused", prints_fused);
+    report_counter("globals promoted", globals_promoted);
+    report_counter("phis inserted", phis_inserted);
+    report_counter("constants propagated", constants_propagated);
+    report_counter("copies propagated", copies_propagated);
+    report_counter("redundant values", redundancies_removed);
+    report_counter("invariants hoisted", invariants_hoisted);
+    report_counter("strength reductions", multiplications_reduced);
+    report_counter("bounds checks removed", bounds_checks_removed);
+    report_counter("temps in registers", temporaries_in_registers);
+    report_counter("temps spilled", temporaries_spilled);
+    report_counter("frame slots", frame_slots);
+    report_counter("movs elided", movs_elided);
+    if (time_report == 2) {
+      print_time_report_json(stderr);
+    } else {
+      print_time_report(stderr);
+    }
+  }
+
+  free_symbol_table(symbols);
+  arena_free(&asm_arena);
+  arena_free(&intermediary_code_arena);
+  arena_free(&semantic_check_arena);
+  arena_free(&syntax_tree_arena);
+  free_interned_strings();
 
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,100 @@
+#include "output.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+Output* make_output(int fd) {
+  Output* out = malloc(sizeof(Output));
+  out->fd = fd;
+  out->close_on_exit = 0;
+  out->failed = 0;
+  out->used = 0;
+  return out;
+}
+
+Output* open_output(const char* path) {
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) {
+    return NULL;
+  }
+  Output* out = make_output(fd);
+  out->close_on_exit = 1;
+  return out;
+}
+
+static void write_all(Output* out, const char* bytes, size_t size) {
+  while (size > 0 && !out->failed) {
+    ssize_t written = write(out->fd, bytes, size);
+    if (written == -1 && errno == EINTR) {
+      continue;
+    }
+    if (written == -1) {
+      out->failed = 1;
+      return;
+    }
+    bytes += written;
+    size -= written;
+  }
+}
+
+void output_flush(Output* out) {
+  write_all(out, out->buffer, out->used);
+  out->used = 0;
+}
+
+int close_output(Output* out) {
+  output_flush(out);
+  int failed = out->failed;
+  if (out->close_on_exit && close(out->fd) == -1) {
+    failed = 1;
+  }
+  free(out);
+  return failed ? -1 : 0;
+}
+
+void output_bytes(Output* out, const char* bytes, size_t size) {
+  if (out->used + size > OUTPUT_BUFFER_SIZE) {
+    output_flush(out);
+    // Too big to be worth copying
+    if (size > OUTPUT_BUFFER_SIZE) {
+      write_all(out, bytes, size);
+      return;
+    }
+  }
+  memcpy(out->buffer + out->used, bytes, size);
+  out->used += size;
+}
+
+void output_string(Output* out, const char* string) { output_bytes(out, string, strlen(string)); }
+
+void output_char(Output* out, char character) {
+  if (out->used == OUTPUT_BUFFER_SIZE) {
+    output_flush(out);
+  }
+  out->buffer[out->used++] = character;
+}
+
+void output_int(Output* out, long value) {
+  // Digits come out backwards, so they are built from the end of the buffer
+  char digits[24];
+  int start = sizeof(digits);
+  unsigned long magnitude = value < 0 ? -(unsigned long)value : (unsigned long)value;
+  do {
+    digits[--start] = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude != 0);
+  if (value < 0) {
+    digits[--start] = '-';
+  }
+  output_bytes(out, digits + start, sizeof(digits) - start);
+}
+
+void output_float(Output* out, double value) {
+  char digits[32];
+  int size = snprintf(digits, sizeof(digits), "%g", value);
+  output_bytes(out, digits, size);
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stddef.h>
+
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+
+// Buffered writer straight on top of a file descriptor. Everything it emits is copied into one big buffer that goes out
+// with a single write(2) once full, so formatting costs a memcpy and no allocations
+typedef struct Output {
+  int fd;
+  int close_on_exit; // Only for descriptors it opened itself
+  int failed;        // Some write(2) went wrong, reported by close_output
+  size_t used;
+  char buffer[OUTPUT_BUFFER_SIZE];
+} Output;
+
+// NULL when the file can't be created, with errno set
+Output* open_output(const char* path);
+Output* make_output(int fd);
+// Flushes, and closes the descriptor when open_output opened it. Returns -1 on write errors
+int close_output(Output* out);
+
+void output_flush(Output* out);
+void output_bytes(Output* out, const char* bytes, size_t size);
+void output_string(Output* out, const char* string);
+void output_char(Output* out, char character);
+void output_int(Output* out, long value);
+void output_float(Output* out, double value); // Same as printf's %g
+
+#endif
\ No newline at end of file
@@ -4,10 +4,12 @@
 #include <stdlib.h>
 #include <string.h>
 
-SemanticErrorList* make_semantic_error_list(SemanticError error) {
-  SemanticErrorList* list = malloc(sizeof(SemanticErrorList));
+Arena semantic_check_arena = { .name = "semantic check" };
 
-  list->error = error;
+static SemanticErrorList* make_error(const char* message) {
+  SemanticErrorList* list = arena_alloc(&semantic_check_arena, sizeof(SemanticErrorList));
+
+  list->error = (SemanticError) { .message = arena_strdup(&semantic_check_arena, message) };
   list->next = NULL;
 
   return list;
@@ -26,90 +28,51 @@ SemanticErrorList* concat_errors(SemanticErrorList* a, SemanticErrorList* b) {
   return a;
 }
 
-datatype(ImplementationSearchResult, (ImplementationNotFound), (ImplementationFound, Implementation));
+// Fills the global scope of the symbol table
+SemanticErrorList* verify_double_declarations(DeclarationList* declarations, SymbolTable* symbols) {
+  char error_message[999];
+  SemanticErrorList* errors = NULL;
 
-DeclarationSearchResult find_declaration(Identifier target, DeclarationList* declarations) {
-  if (declarations == NULL) {
-    return DeclarationNotFound();
-  }
+  while (declarations != NULL) {
+    if (declare_symbol(symbols, declarations->declaration) == NULL) {
+      Identifier identifier;
+      match(declarations->declaration) {
+        of(VariableDeclaration, _, i) identifier = *i;
+        of(FunctionDeclaration, _, i) identifier = *i;
+        of(ArrayDeclaration, _, i) identifier = *i;
+      }
 
-  Identifier identifier;
-  Type type;
-  match(declarations->declaration) {
-    of(VariableDeclaration, t, i) {
-      identifier = *i;
-      type = *t;
-    }
-    of(FunctionDeclaration, t, i) {
-      identifier = *i;
-      type = *t;
-    }
-    of(ArrayDeclaration, t, i) {
-      identifier = *i;
-      type = *t;
+      snprintf(
+          error_message, sizeof(error_message), "identificador \"%s\" declarado mais de uma vez", string_of(identifier)
+      );
+      errors = concat_errors(errors, make_error(error_message));
     }
-  }
-
-  if (strcmp(identifier, target) == 0) {
-    return DeclarationFound(declarations->declaration, type, identifier);
-  }
-
-  return find_declaration(target, declarations->next);
-}
-
-ImplementationSearchResult find_implementation(Identifier target, ImplementationList* implementations) {
-  if (implementations == NULL) {
-    return ImplementationNotFound();
-  }
-
-  if (strcmp(implementations->implementation.name, target) == 0) {
-    return ImplementationFound(implementations->implementation);
-  }
-
-  return find_implementation(target, implementations->next);
-}
-
-SemanticErrorList* verify_double_declarations(DeclarationList* declarations) {
-  if (declarations == NULL) {
-    return NULL;
-  }
-
-  Declaration declaration = declarations->declaration;
 
-  Identifier identifier;
-  match(declaration) {
-    of(VariableDeclaration, _, i) identifier = *i;
-    of(FunctionDeclaration, _, i) identifier = *i;
-    of(ArrayDeclaration, _, i) identifier = *i;
-  }
-
-  SemanticErrorList* error = NULL;
-  SemanticErrorList* next_errors = verify_double_declarations(declarations->next);
-
-  if (MATCHES(find_declaration(identifier, declarations->next), DeclarationFound)) {
-    char error_message[999];
-    snprintf(error_message, sizeof(error_message), "identificador \"%s\" declarado mais de uma vez", identifier);
-
-    error = make_semantic_error_list((SemanticError) { .message = strdup(error_message) });
-    error->next = next_errors;
+    declarations = declarations->next;
   }
 
-  return error != NULL ? error : next_errors;
+  return errors;
 }
 
-SemanticErrorList* verify_double_implementations(ImplementationList* implementations) {
+// Links each declared function to its implementation
+SemanticErrorList* verify_double_implementations(ImplementationList* implementations, SymbolTable* symbols) {
   char error_message[999];
   SemanticErrorList* errors = NULL;
 
   while (implementations != NULL) {
-    if (MATCHES(
-            find_implementation(implementations->implementation.name, implementations->next), ImplementationFound
-        )) {
-      snprintf(
-          error_message, sizeof(error_message), "identificador \"%s\" declarado mais de uma vez",
-          implementations->implementation.name
-      );
-      errors = concat_errors(errors, make_semantic_error_list((SemanticError) { .message = strdup(error_message) }));
+    Symbol* symbol = find_symbol(symbols, implementations->implementation.name);
+
+    // Implementations without declarations are reported by verify_implementation
+    if (symbol != NULL) {
+      if (symbol->implementation != NULL) {
+        snprintf(
+            error_message, sizeof(error_message), "identificador \"%s\" declarado mais de uma vez",
+            string_of(implementations->implementation.name)
+        );
+        errors = concat_errors(errors, make_error(error_message));
+      } else {
+        symbol->implementation = &implementations->implementation;
+      }
     }
 
     implementations = implementations->next;
@@ -123,9 +86,12 @@ datatype(HigherOrderType, (IntegerHigher), (FloatHigher), (CharHigher), (Boolean
 datatype(ExpressionType, (InvalidType), (ValidType, HigherOrderType));
 datatype(OptionExpressionType, (NoneExpressionType), (SomeExpressionType, ExpressionType));
 
+int is_integral(HigherOrderType type) { return MATCHES(type, IntegerHigher) || MATCHES(type, CharHigher); }
+
+// Ints and chars also widen to floats, but floats never narrow back implicitly
 int is_assignable_to(HigherOrderType storing, HigherOrderType stored) {
-  return storing.tag == stored.tag || MATCHES(storing, IntegerHigher) && MATCHES(stored, CharHigher) ||
-         MATCHES(storing, CharHigher) && MATCHES(stored, IntegerHigher);
+  return storing.tag == stored.tag || (is_integral(storing) && is_integral(stored)) ||
+         (MATCHES(storing, FloatHigher) && is_integral(stored));
 }
 
 const char* higher_to_string(HigherOrderType type) {
@@ -151,12 +117,12 @@ HigherOrderType type_to_higher(Type type) {
   return IntegerHigher();
 }
 
-ExpressionType get_expression_type(Expression expression, DeclarationList* declarations);
+ExpressionType get_expression_type(Expression expression, SymbolTable* symbols);
 
 ExpressionType
-get_binary_expression_type(BinaryOperator operator, Expression left, Expression right, DeclarationList* declarations) {
-  ExpressionType left_result = get_expression_type(left, declarations);
-  ExpressionType right_result = get_expression_type(right, declarations);
+get_binary_expression_type(BinaryOperator operator, Expression left, Expression right, SymbolTable* symbols) {
+  ExpressionType left_result = get_expression_type(left, symbols);
+  ExpressionType right_result = get_expression_type(right, symbols);
 
   HigherOrderType left_type, right_type;
   match(left_result) {
@@ -183,18 +149,21 @@ get_binary_expression_type(BinaryOperator operator, Expression left, Expression
     if (MATCHES(left_type, IntegerHigher) && MATCHES(right_type, IntegerHigher)) {
       return ValidType(IntegerHigher());
     }
-    if (MATCHES(left_type, FloatHigher) && MATCHES(right_type, FloatHigher)) {
+    if ((MATCHES(left_type, FloatHigher) && (MATCHES(right_type, FloatHigher) || is_integral(right_type))) ||
+        (is_integral(left_type) && MATCHES(right_type, FloatHigher))) {
       return ValidType(FloatHigher());
     }
-    if (MATCHES(left_type, CharHigher) && MATCHES(right_type, IntegerHigher) ||
-        MATCHES(left_type, IntegerHigher) && MATCHES(right_type, CharHigher)) {
+    if ((MATCHES(left_type, CharHigher) && MATCHES(right_type, IntegerHigher)) ||
+        (MATCHES(left_type, IntegerHigher) && MATCHES(right_type, CharHigher))) {
       return ValidType(IntegerHigher());
     }
     return InvalidType();
   }
 
   if (is_comparison) {
-    if (left_type.tag == right_type.tag) {
+    int is_mixed_float = (MATCHES(left_type, FloatHigher) && is_integral(right_type)) ||
+                         (is_integral(left_type) && MATCHES(right_type, FloatHigher));
+    if (left_type.tag == right_type.tag || is_mixed_float) {
       return ValidType(BooleanHigher());
     }
     return InvalidType();
@@ -211,7 +180,7 @@ get_binary_expression_type(BinaryOperator operator, Expression left, Expression
   return InvalidType();
 }
 
-ExpressionType get_expression_type(Expression expression, DeclarationList* declarations) {
+ExpressionType get_expression_type(Expression expression, SymbolTable* symbols) {
   match(expression) {
     of(LiteralExpression, literal) {
       match(*literal) {
@@ -222,7 +191,7 @@ ExpressionType get_expression_type(Expression expression, DeclarationList* decla
       }
     }
     of(IdentifierExpression, identifier) {
-      DeclarationSearchResult searchResult = find_declaration(*identifier, declarations);
+      DeclarationSearchResult searchResult = find_declaration(*identifier, symbols);
       match(searchResult) {
         of(DeclarationNotFound) return InvalidType();
         of(DeclarationFound, declaration) {
@@ -234,7 +203,7 @@ ExpressionType get_expression_type(Expression expression, DeclarationList* decla
       }
     }
     of(ReadArrayExpression, identifier) {
-      DeclarationSearchResult searchResult = find_declaration(*identifier, declarations);
+      DeclarationSearchResult searchResult = find_declaration(*identifier, symbols);
       match(searchResult) {
         of(DeclarationNotFound) return InvalidType();
         of(DeclarationFound, declaration) {
@@ -246,7 +215,7 @@ ExpressionType get_expression_type(Expression expression, DeclarationList* decla
       }
     }
     of(FunctionCallExpression, identifier) {
-      DeclarationSearchResult searchResult = find_declaration(*identifier, declarations);
+      DeclarationSearchResult searchResult = find_declaration(*identifier, symbols);
       match(searchResult) {
         of(DeclarationNotFound) return InvalidType();
         of(DeclarationFound, declaration) {
@@ -260,7 +229,7 @@ ExpressionType get_expression_type(Expression expression, DeclarationList* decla
     of(InputExpression, type) return ValidType(type_to_higher(*type));
     of(BinaryExpression, operator, left, right) {
       //                                          vvvv Why clang-format is doing this is a mystery :O
-      return get_binary_expression_type(*operator, ** left, **right, declarations);
+      return get_binary_expression_type(*operator, ** left, **right, symbols);
     }
   }
 
@@ -299,18 +268,18 @@ OptionExpressionType join_types(OptionExpressionType a, OptionExpressionType b)
   return SomeExpressionType(InvalidType());
 }
 
-SemanticErrorList* verify_expression(Expression expression, DeclarationList* declarations) {
+SemanticErrorList* verify_expression(Expression expression, SymbolTable* symbols) {
   char error_message[999];
   SemanticErrorList* error = NULL;
 
   match(expression) {
     of(LiteralExpression, literal) { }
     of(IdentifierExpression, identifier) {
-      DeclarationSearchResult searchResult = find_declaration(*identifier, declarations);
+      DeclarationSearchResult searchResult = find_declaration(*identifier, symbols);
       match(searchResult) {
         of(DeclarationNotFound) {
-          snprintf(error_message, sizeof(error_message), "identificador \"%s\" não encontrado", *identifier);
-          error = concat_errors(error, make_semantic_error_list((SemanticError) { .message = strdup(error_message) }));
+          snprintf(error_message, sizeof(error_message), "identificador \"%s\" não encontrado", string_of(*identifier));
+          error = concat_errors(error, make_error(error_message));
         }
         of(DeclarationFound, declaration) {
           match(*declaration) {
@@ -318,39 +287,37 @@ SemanticErrorList* verify_expression(Expression expression, DeclarationList* dec
             otherwise {
               snprintf(
                   error_message, sizeof(error_message), "identificador \"%s\" não-escalar aparece em expressão",
-                  *identifier
+                  string_of(*identifier)
               );
-              error =
-                  concat_errors(error, make_semantic_error_list((SemanticError) { .message = strdup(error_message) }));
+              error = concat_errors(error, make_error(error_message));
             }
           }
         }
       }
     }
     of(ReadArrayExpression, identifier, index) {
-      error = concat_errors(error, verify_expression(**index, declarations));
+      error = concat_errors(error, verify_expression(**index, symbols));
 
-      ExpressionType index_type = get_expression_type(**index, declarations);
+      ExpressionType index_type = get_expression_type(**index, symbols);
       match(index_type) {
         of(ValidType, higher) {
           if (!is_assignable_to(IntegerHigher(), *higher)) {
             snprintf(
                 error_message, sizeof(error_message),
                 "expressão do tipo %s usada para indexar vetor \"%s\", esperava int", higher_to_string(*higher),
-                *identifier
+                string_of(*identifier)
             );
-            error =
-                concat_errors(error, make_semantic_error_list((SemanticError) { .message = strdup(error_message) }));
+            error = concat_errors(error, make_error(error_message));
           }
         }
         otherwise { }
       }
 
-      DeclarationSearchResult searchResult = find_declaration(*identifier, declarations);
+      DeclarationSearchResult searchResult = find_declaration(*identifier, symbols);
       match(searchResult) {
         of(DeclarationNotFound) {
-          snprintf(error_message, sizeof(error_message), "identificador \"%s\" não encontrado", *identifier);
-          error = concat_errors(error, make_semantic_error_list((SemanticError) { .message = strdup(error_message) }));
+          snprintf(error_message, sizeof(error_message), "identificador \"%s\" não encontrado", string_of(*identifier));
+          error = concat_errors(error, make_error(error_message));
         }
         of(DeclarationFound, declaration) {
           match(*declaration) {
@@ -358,21 +325,20 @@ SemanticErrorList* verify_expression(Expression expression, DeclarationList* dec
             otherwise {
               snprintf(
                   error_message, sizeof(error_message), "identificador não-vetorial \"%s\" indexado como vetor",
-                  *identifier
+                  string_of(*identifier)
               );
-              error =
-                  concat_errors(error, make_semantic_error_list((SemanticError) { .message = strdup(error_message) }));
+              error = concat_errors(error, make_error(error_message));
             }
           }
         }
       }
     }
     of(FunctionCallExpression, identifier, aarguments) {
-      DeclarationSearchResult searchResult = find_declaration(*identifier, declarations);
+      DeclarationSearchResult searchResult = find_declaration(*identifier, symbols);
       match(searchResult) {
         of(DeclarationNotFound) {
-          snprintf(error_message, sizeof(error_message), "uso de função não-declarada \"%s\"", *identifier);
-          error = concat_errors(error, make_semantic_error_list((SemanticError) { .message = strdup(error_message) }));
+          snprintf(error_message, sizeof(error_message), "uso de função não-declarada \"%s\"", string_of(*identifier));
+          error = concat_errors(error, make_error(error_message));
         }
         of(DeclarationFound, declaration) {
           match(*declaration) {
@@ -382,19 +348,17 @@ SemanticErrorList* verify_expression(Expression expression, DeclarationList* dec
               int neededArguments = 0, passedArguments = 0;
 
               while (arguments != NULL && parameters != NULL) {
-                ExpressionType type = get_expression_type(arguments->argument, declarations);
+                ExpressionType type = get_expression_type(arguments->argument, symbols);
                 match(type) {
                   of(ValidType, higher) {
                     if (!is_assignable_to(type_to_higher(parameters->type), *higher)) {
                       snprintf(
                           error_message, sizeof(error_message),
                           "tipo %s passado para \"%s\" na chamada da função \"%s\", esperava %s",
-                          higher_to_string(*higher), parameters->name, *identifier,
+                          higher_to_string(*higher), string_of(parameters->name), string_of(*identifier),
                           higher_to_string(type_to_higher(parameters->type))
                       );
-                      error = concat_errors(
-                          error, make_semantic_error_list((SemanticError) { .message = strdup(error_message) })
-                      );
+                      error = concat_errors(error, make_error(error_message));
                     }
                   }
                   otherwise { }
@@ -417,21 +381,18 @@ SemanticErrorList* verify_expression(Expression expression, DeclarationList* dec
 
               if (neededArguments != passedArguments) {
                 snprintf(
-                    error_message, sizeof(error_message), "\"%s\" esperava %d argumentos, mas recebeu %d", *identifier,
-                    neededArguments, passedArguments
-                );
-                error = concat_errors(
-                    error, make_semantic_error_list((SemanticError) { .message = strdup(error_message) })
+                    error_message, sizeof(error_message), "\"%s\" esperava %d argumentos, mas recebeu %d",
+                    string_of(*identifier), neededArguments, passedArguments
                 );
+                error = concat_errors(error, make_error(error_message));
               }
             }
             otherwise {
               snprintf(
                   error_message, sizeof(error_message), "identificador não-chamável \"%s\" usado como função",
-                  *identifier
+                  string_of(*identifier)
               );
-              error =
-                  concat_errors(error, make_semantic_error_list((SemanticError) { .message = strdup(error_message) }));
+              error = concat_errors(error, make_error(error_message));
             }
           }
         }
@@ -439,24 +400,22 @@ SemanticErrorList* verify_expression(Expression expression, DeclarationList* dec
     }
     of(InputExpression, type) { }
     of(BinaryExpression, operator, left, right) {
-      error = concat_errors(error, verify_expression(**left, declarations));
-      error = concat_errors(error, verify_expression(**right, declarations));
+      error = concat_errors(error, verify_expression(**left, symbols));
+      error = concat_errors(error, verify_expression(**right, symbols));
 
-      ExpressionType left_type = get_expression_type(**left, declarations);
-      ExpressionType right_type = get_expression_type(**right, declarations);
+      ExpressionType left_type = get_expression_type(**left, symbols);
+      ExpressionType right_type = get_expression_type(**right, symbols);
 
       match(left_type) {
         of(ValidType, left_higher) {
           match(right_type) {
             of(ValidType, right_higher) {
-              if (!is_assignable_to(*left_higher, *right_higher)) {
+              if (!is_assignable_to(*left_higher, *right_higher) && !is_assignable_to(*right_higher, *left_higher)) {
                 snprintf(
                     error_message, sizeof(error_message), "expressão binária com tipos incompatíveis: %s e %s",
                     higher_to_string(*left_higher), higher_to_string(*right_higher)
                 );
-                error = concat_errors(
-                    error, make_semantic_error_list((SemanticError) { .message = strdup(error_message) })
-                );
+                error = concat_errors(error, make_error(error_message));
               }
             }
             otherwise { }
@@ -470,35 +429,33 @@ SemanticErrorList* verify_expression(Expression expression, DeclarationList* dec
   return error;
 }
 
-SemanticErrorList* verify_statement(Statement statement, DeclarationList* declarations) {
+SemanticErrorList* verify_statement(Statement statement, SymbolTable* symbols) {
   char error_message[999];
   SemanticErrorList* error = NULL;
 
   match(statement) {
     of(AssignmentStatement, identifier, value) {
-      error = concat_errors(error, verify_expression(*value, declarations));
-      DeclarationSearchResult search_result = find_declaration(*identifier, declarations);
+      error = concat_errors(error, verify_expression(*value, symbols));
+      DeclarationSearchResult search_result = find_declaration(*identifier, symbols);
       match(search_result) {
         of(DeclarationNotFound) {
-          snprintf(error_message, sizeof(error_message), "identificador \"%s\" não encontrado", *identifier);
-          error = concat_errors(error, make_semantic_error_list((SemanticError) { .message = strdup(error_message) }));
+          snprintf(error_message, sizeof(error_message), "identificador \"%s\" não encontrado", string_of(*identifier));
+          error = concat_errors(error, make_error(error_message));
         }
         of(DeclarationFound, declaration) {
           match(*declaration) {
             of(VariableDeclaration, type) {
               HigherOrderType variable_type = type_to_higher(*type);
-              ExpressionType value_maybe_type = get_expression_type(*value, declarations);
+              ExpressionType value_maybe_type = get_expression_type(*value, symbols);
               match(value_maybe_type) {
                 of(ValidType, value_type) {
                   if (!is_assignable_to(variable_type, *value_type)) {
                     snprintf(
                         error_message, sizeof(error_message),
                         "impossível atribuir valor do tipo %s à variável \"%s\" do tipo %s",
-                        higher_to_string(*value_type), *identifier, higher_to_string(variable_type)
-                    );
-                    error = concat_errors(
-                        error, make_semantic_error_list((SemanticError) { .message = strdup(error_message) })
+                        higher_to_string(*value_type), string_of(*identifier), higher_to_string(variable_type)
                     );
+                    error = concat_errors(error, make_error(error_message));
                     return error;
                   }
                 }
@@ -506,55 +463,54 @@ SemanticErrorList* verify_statement(Statement statement, DeclarationList* declar
               }
             }
             otherwise {
-              snprintf(error_message, sizeof(error_message), "atribuição à símbolo não-variável \"%s\"", *identifier);
-              error =
-                  concat_errors(error, make_semantic_error_list((SemanticError) { .message = strdup(error_message) }));
+              snprintf(
+                  error_message, sizeof(error_message), "atribuição à símbolo não-variável \"%s\"",
+                  string_of(*identifier)
+              );
+              error = concat_errors(error, make_error(error_message));
             }
           }
         }
       }
     }
     of(ArrayAssignmentStatement, identifier, index, value) {
-      error = concat_errors(error, verify_expression(*value, declarations));
-      error = concat_errors(error, verify_expression(*index, declarations));
+      error = concat_errors(error, verify_expression(*value, symbols));
+      error = concat_errors(error, verify_expression(*index, symbols));
 
-      ExpressionType index_maybe_type = get_expression_type(*index, declarations);
+      ExpressionType index_maybe_type = get_expression_type(*index, symbols);
       match(index_maybe_type) {
         of(ValidType, higher) {
           if (!is_assignable_to(IntegerHigher(), *higher)) {
             snprintf(
                 error_message, sizeof(error_message), "impossível usar tipo %s no acesso ao vetor \"%s\"",
-                higher_to_string(*higher), *identifier
+                higher_to_string(*higher), string_of(*identifier)
             );
-            error =
-                concat_errors(error, make_semantic_error_list((SemanticError) { .message = strdup(error_message) }));
+            error = concat_errors(error, make_error(error_message));
           }
         }
         otherwise { }
       }
 
-      DeclarationSearchResult search_result = find_declaration(*identifier, declarations);
+      DeclarationSearchResult search_result = find_declaration(*identifier, symbols);
       match(search_result) {
         of(DeclarationNotFound) {
-          snprintf(error_message, sizeof(error_message), "identificador \"%s\" não encontrado", *identifier);
-          error = concat_errors(error, make_semantic_error_list((SemanticError) { .message = strdup(error_message) }));
+          snprintf(error_message, sizeof(error_message), "identificador \"%s\" não encontrado", string_of(*identifier));
+          error = concat_errors(error, make_error(error_message));
         }
         of(DeclarationFound, declaration) {
           match(*declaration) {
             of(ArrayDeclaration, type) {
               HigherOrderType variable_type = type_to_higher(*type);
-              ExpressionType value_maybe_type = get_expression_type(*value, declarations);
+              ExpressionType value_maybe_type = get_expression_type(*value, symbols);
               match(value_maybe_type) {
                 of(ValidType, value_type) {
                   if (!is_assignable_to(variable_type, *value_type)) {
                     snprintf(
                         error_message, sizeof(error_message),
                         "impossível atribuir valor do tipo %s a índice da variável \"%s\" do tipo %s[]",
-                        higher_to_string(*value_type), *identifier, higher_to_string(variable_type)
-                    );
-                    error = concat_errors(
-                        error, make_semantic_error_list((SemanticError) { .message = strdup(error_message) })
+                        higher_to_string(*value_type), string_of(*identifier), higher_to_string(variable_type)
                     );
+                    error = concat_errors(error, make_error(error_message));
                     return error;
                   }
                 }
@@ -563,73 +519,70 @@ SemanticErrorList* verify_statement(Statement statement, DeclarationList* declar
             }
             otherwise {
               snprintf(
-                  error_message, sizeof(error_message), "atribuição indexada a valor não-vetorial \"%s\"", *identifier
+                  error_message, sizeof(error_message), "atribuição indexada a valor não-vetorial \"%s\"",
+                  string_of(*identifier)
               );
-              error =
-                  concat_errors(error, make_semantic_error_list((SemanticError) { .message = strdup(error_message) }));
+              error = concat_errors(error, make_error(error_message));
             }
           }
         }
       }
     }
-    of(PrintStatement, expr) error = concat_errors(error, verify_expression(*expr, declarations));
-    of(ReturnStatement, expr) error = concat_errors(error, verify_expression(*expr, declarations));
+    of(PrintStatement, expr) error = concat_errors(error, verify_expression(*expr, symbols));
+    of(ReturnStatement, expr) error = concat_errors(error, verify_expression(*expr, symbols));
     of(IfStatement, cond, true_branch) {
-      error = verify_expression(*cond, declarations);
+      error = verify_expression(*cond, symbols);
 
-      ExpressionType cond_type = get_expression_type(*cond, declarations);
+      ExpressionType cond_type = get_expression_type(*cond, symbols);
       match(cond_type) {
         of(ValidType, higher) {
           if (!MATCHES(*higher, BooleanHigher)) {
             snprintf(error_message, sizeof(error_message), "condição não booleana em bloco if");
-            error =
-                concat_errors(error, make_semantic_error_list((SemanticError) { .message = strdup(error_message) }));
+            error = concat_errors(error, make_error(error_message));
           }
         }
         otherwise { }
       }
 
-      error = concat_errors(error, verify_statement(**true_branch, declarations));
+      error = concat_errors(error, verify_statement(**true_branch, symbols));
     }
     of(IfElseStatement, cond, true_branch, false_branch) {
-      error = verify_expression(*cond, declarations);
+      error = verify_expression(*cond, symbols);
 
-      ExpressionType cond_type = get_expression_type(*cond, declarations);
+      ExpressionType cond_type = get_expression_type(*cond, symbols);
       match(cond_type) {
         of(ValidType, higher) {
           if (!MATCHES(*higher, BooleanHigher)) {
             snprintf(error_message, sizeof(error_message), "condição não booleana em bloco if");
-            error =
-                concat_errors(error, make_semantic_error_list((SemanticError) { .message = strdup(error_message) }));
+            error = concat_errors(error, make_error(error_message));
           }
         }
         otherwise { }
       }
 
-      error = concat_errors(error, verify_statement(**true_branch, declarations));
-      error = concat_errors(error, verify_statement(**false_branch, declarations));
+      error = concat_errors(error, verify_statement(**true_branch, symbols));
+      error = concat_errors(error, verify_statement(**false_branch, symbols));
     }
     of(WhileStatement, cond, body) {
-      error = verify_expression(*cond, declarations);
+      error = verify_expression(*cond, symbols);
 
-      ExpressionType cond_type = get_expression_type(*cond, declarations);
+      ExpressionType cond_type = get_expression_type(*cond, symbols);
       match(cond_type) {
         of(ValidType, higher) {
           if (!MATCHES(*higher, BooleanHigher)) {
             snprintf(error_message, sizeof(error_message), "condição não booleana em bloco while");
-            error =
-                concat_errors(error, make_semantic_error_list((SemanticError) { .message = strdup(error_message) }));
+            error = concat_errors(error, make_error(error_message));
           }
         }
         otherwise { }
       }
 
-      error = concat_errors(error, verify_statement(**body, declarations));
+      error = concat_errors(error, verify_statement(**body, symbols));
     }
     of(BlockStatement, llist) {
       StatementList* list = *llist;
       while (list != NULL) {
-        error = concat_errors(error, verify_statement(list->statement, declarations));
+        error = concat_errors(error, verify_statement(list->statement, symbols));
         list = list->next;
       }
     }
@@ -639,18 +592,18 @@ SemanticErrorList* verify_statement(Statement statement, DeclarationList* declar
   return error;
 }
 
-int does_statement_always_return(Statement statement, DeclarationList* declarations) {
+int does_statement_always_return(Statement statement, SymbolTable* symbols) {
   match(statement) {
     of(ReturnStatement) { return 1; }
     of(IfElseStatement, _, true_block, false_block) {
-      return does_statement_always_return(**true_block, declarations) &&
-             does_statement_always_return(**false_block, declarations);
+      return does_statement_always_return(**true_block, symbols) &&
+             does_statement_always_return(**false_block, symbols);
     }
     of(BlockStatement, s) {
       StatementList* list = *s;
       // If at least 1 statement is garanteed to return, we're safe
       while (list != NULL) {
-        if (does_statement_always_return(list->statement, declarations)) {
+        if (does_statement_always_return(list->statement, symbols)) {
           return 1;
         }
         list = list->next;
@@ -665,60 +618,62 @@ int does_statement_always_return(Statement statement, DeclarationList* declarati
 }
 
 SemanticErrorList*
-verify_implementation_all_branches_return(Implementation implementation, DeclarationList* declarations) {
+verify_implementation_all_branches_return(Implementation implementation, SymbolTable* symbols) {
   char error_message[999];
   SemanticErrorList* errors = NULL;
 
-  if (!does_statement_always_return(implementation.body, declarations)) {
-    snprintf(error_message, sizeof(error_message), "função \"%s\" contém ramos sem retorno", implementation.name);
-    errors = concat_errors(errors, make_semantic_error_list((SemanticError) { .message = strdup(error_message) }));
+  if (!does_statement_always_return(implementation.body, symbols)) {
+    snprintf(
+        error_message, sizeof(error_message), "função \"%s\" contém ramos sem retorno", string_of(implementation.name)
+    );
+    errors = concat_errors(errors, make_error(error_message));
   }
 
   return errors;
 }
 
 SemanticErrorList* verify_statement_return_types(
-    Statement statement, Identifier function_identifier, Type expected_return, DeclarationList* declarations
+    Statement statement, Identifier function_identifier, Type expected_return, SymbolTable* symbols
 ) {
   char error_message[999];
   SemanticErrorList* errors = NULL;
 
   match(statement) {
     of(ReturnStatement, expr) {
-      ExpressionType expr_type = get_expression_type(*expr, declarations);
+      ExpressionType expr_type = get_expression_type(*expr, symbols);
       match(expr_type) {
         of(ValidType, higher) {
           if (!is_assignable_to(type_to_higher(expected_return), *higher)) {
             snprintf(
                 error_message, sizeof(error_message), "retorno do tipo %s é inválido para função \"%s\" do tipo %s",
-                higher_to_string(*higher), function_identifier, higher_to_string(type_to_higher(expected_return))
+                higher_to_string(*higher), string_of(function_identifier),
+                higher_to_string(type_to_higher(expected_return))
             );
-            errors =
-                concat_errors(errors, make_semantic_error_list((SemanticError) { .message = strdup(error_message) }));
+            errors = concat_errors(errors, make_error(error_message));
           }
         }
         otherwise { }
       }
     }
     of(IfStatement, _, block) errors = concat_errors(
-        errors, verify_statement_return_types(**block, function_identifier, expected_return, declarations)
+        errors, verify_statement_return_types(**block, function_identifier, expected_return, symbols)
     );
     of(IfElseStatement, _, true_block, false_block) {
       errors = concat_errors(
-          errors, verify_statement_return_types(**true_block, function_identifier, expected_return, declarations)
+          errors, verify_statement_return_types(**true_block, function_identifier, expected_return, symbols)
       );
       errors = concat_errors(
-          errors, verify_statement_return_types(**false_block, function_identifier, expected_return, declarations)
+          errors, verify_statement_return_types(**false_block, function_identifier, expected_return, symbols)
       );
     }
     of(WhileStatement, _, block) errors = concat_errors(
-        errors, verify_statement_return_types(**block, function_identifier, expected_return, declarations)
+        errors, verify_statement_return_types(**block, function_identifier, expected_return, symbols)
     );
     of(BlockStatement, s) {
       StatementList* list = *s;
       while (list != NULL) {
         errors = concat_errors(
-            errors, verify_statement_return_types(list->statement, function_identifier, expected_return, declarations)
+            errors, verify_statement_return_types(list->statement, function_identifier, expected_return, symbols)
         );
         list = list->next;
       }
@@ -729,65 +684,45 @@ SemanticErrorList* verify_statement_return_types(
   return errors;
 }
 
-DeclarationList* concat_params(ParametersDeclaration* params, DeclarationList* declarations) {
-  DeclarationList* head = NULL;
-  DeclarationList* tail = NULL;
-
-  while (params != NULL) {
-    // HACK: Put a non-type-matching initial value inside the declaration
-    DeclarationList* new_node = make_declaration(VariableDeclaration(params->type, params->name, IntLiteral(0)));
-
-    if (tail != NULL) {
-      tail->next = new_node;
-    }
-    tail = new_node;
-
-    if (head == NULL) {
-      head = tail;
-    }
-
-    params = params->next;
-  }
-  if (tail != NULL) {
-    tail->next = declarations;
-  }
-
-  return head != NULL ? head : declarations;
-}
-
-SemanticErrorList* verify_implementation(Implementation implementation, DeclarationList* declarations) {
-  // TODO: Prepend declarations with function parameters?
-
+SemanticErrorList* verify_implementation(Implementation implementation, SymbolTable* symbols) {
   char error_message[999];
   SemanticErrorList* errors = NULL;
 
-  DeclarationSearchResult declaration_result = find_declaration(implementation.name, declarations);
+  DeclarationSearchResult declaration_result = find_declaration(implementation.name, symbols);
   match(declaration_result) {
     of(DeclarationFound, declaration) {
       match(*declaration) {
         of(FunctionDeclaration, function_type, _, params) {
-          DeclarationList* context = concat_params(*params, declarations);
+          push_scope(symbols);
+          ParametersDeclaration* param = *params;
+          while (param != NULL) {
+            // HACK: Put a non-type-matching initial value inside the declaration
+            declare_symbol(symbols, VariableDeclaration(param->type, param->name, IntLiteral(0)));
+            param = param->next;
+          }
 
           errors = concat_errors(
-              errors, verify_statement_return_types(implementation.body, implementation.name, *function_type, context)
+              errors, verify_statement_return_types(implementation.body, implementation.name, *function_type, symbols)
           );
-          errors = concat_errors(errors, verify_implementation_all_branches_return(implementation, context));
-          errors = concat_errors(errors, verify_statement(implementation.body, context));
+          errors = concat_errors(errors, verify_implementation_all_branches_return(implementation, symbols));
+          errors = concat_errors(errors, verify_statement(implementation.body, symbols));
+
+          pop_scope(symbols);
         }
         otherwise {
           snprintf(
               error_message, sizeof(error_message), "função \"%s\" implementada mas declarada com tipo não-função",
-              implementation.name
+              string_of(implementation.name)
           );
-          errors =
-              concat_errors(errors, make_semantic_error_list((SemanticError) { .message = strdup(error_message) }));
+          errors = concat_errors(errors, make_error(error_message));
         }
       }
       of(DeclarationNotFound) {
         snprintf(
-            error_message, sizeof(error_message), "função \"%s\" implementada mas não declarada", implementation.name
+            error_message, sizeof(error_message), "função \"%s\" implementada mas não declarada",
+            string_of(implementation.name)
         );
-        errors = concat_errors(errors, make_semantic_error_list((SemanticError) { .message = strdup(error_message) }));
+        errors = concat_errors(errors, make_error(error_message));
       }
     }
   }
@@ -795,21 +730,20 @@ SemanticErrorList* verify_implementation(Implementation implementation, Declarat
   return errors;
 }
 
-SemanticErrorList* verify_missing_implementation(DeclarationList* declarations, ImplementationList* implementations) {
+SemanticErrorList* verify_missing_implementation(DeclarationList* declarations, SymbolTable* symbols) {
   char error_message[999];
   SemanticErrorList* errors = NULL;
 
   while (declarations != NULL) {
     match(declarations->declaration) {
       of(FunctionDeclaration, _, identifier) {
-        ImplementationSearchResult result = find_implementation(*identifier, implementations);
-        match(result) {
-          of(ImplementationNotFound) {
-            snprintf(error_message, sizeof(error_message), "função \"%s\" declarada mas não implementada", *identifier);
-            errors =
-                concat_errors(errors, make_semantic_error_list((SemanticError) { .message = strdup(error_message) }));
-          }
-          otherwise { }
+        Symbol* symbol = find_symbol(symbols, *identifier);
+        if (symbol->implementation == NULL) {
+          snprintf(
+              error_message, sizeof(error_message), "função \"%s\" declarada mas não implementada",
+              string_of(*identifier)
+          );
+          errors = concat_errors(errors, make_error(error_message));
         }
       }
       otherwise { }
@@ -821,16 +755,16 @@ SemanticErrorList* verify_missing_implementation(DeclarationList* declarations,
   return errors;
 }
 
-SemanticErrorList* verify_program(Program program) {
+SemanticErrorList* verify_program(Program program, SymbolTable* symbols) {
   SemanticErrorList* errors = NULL;
 
-  errors = concat_errors(errors, verify_missing_implementation(program.declarations, program.implementations));
-  errors = concat_errors(errors, verify_double_implementations(program.implementations));
-  errors = concat_errors(errors, verify_double_declarations(program.declarations));
+  errors = concat_errors(errors, verify_double_declarations(program.declarations, symbols));
+  errors = concat_errors(errors, verify_double_implementations(program.implementations, symbols));
+  errors = concat_errors(errors, verify_missing_implementation(program.declarations, symbols));
 
   ImplementationList* implementations = program.implementations;
   while (implementations != NULL) {
-    errors = concat_errors(errors, verify_implementation(implementations->implementation, program.declarations));
+    errors = concat_errors(errors, verify_implementation(implementations->implementation, symbols));
 
     implementations = implementations->next;
   }
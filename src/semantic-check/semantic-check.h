@@ -1,5 +1,7 @@
 #ifndef SEMANTIC_CHECK_H
+#define SEMANTIC_CHECK_H
 
+#include "symbol-table.h"
 #include "syntax-tree.h"
 
 typedef struct {
@@ -11,9 +13,8 @@ typedef struct SemanticErrorList {
   struct SemanticErrorList* next;
 } SemanticErrorList;
 
-SemanticErrorList* verify_program(Program Program);
+extern Arena semantic_check_arena;
 
-datatype(DeclarationSearchResult, (DeclarationNotFound), (DeclarationFound, Declaration, Type, Identifier));
-DeclarationSearchResult find_declaration(Identifier target, DeclarationList* declarations);
+SemanticErrorList* verify_program(Program Program, SymbolTable* symbols);
 
 #endif
\ No newline at end of file
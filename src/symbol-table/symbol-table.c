@@ -0,0 +1,146 @@
+#include "symbol-table.h"
+
+#include <string.h>
+
+// Identifiers are interned, so their handles are already unique
+static unsigned int hash(Identifier identifier) { return identifier * 2654435761u; }
+
+static void insert_in_bucket(SymbolTable* table, Symbol* symbol) {
+  unsigned int bucket = hash(symbol->name) & (table->bucket_count - 1);
+  symbol->next_in_bucket = table->buckets[bucket];
+  table->buckets[bucket] = symbol;
+}
+
+static Symbol** make_buckets(SymbolTable* table) {
+  Symbol** buckets = arena_alloc(&table->arena, table->bucket_count * sizeof(Symbol*));
+  memset(buckets, 0, table->bucket_count * sizeof(Symbol*));
+  return buckets;
+}
+
+static void grow_buckets(SymbolTable* table) {
+  table->bucket_count *= 2;
+  table->buckets = make_buckets(table);
+
+  // Reinserting in declaration order keeps shadowing symbols at the front of their buckets
+  for (int i = 0; i < table->symbol_count; i++) {
+    insert_in_bucket(table, table->symbols[i]);
+  }
+}
+
+SymbolTable* make_symbol_table() {
+  Arena arena = { .name = "symbol table" };
+  SymbolTable* table = arena_alloc(&arena, sizeof(SymbolTable));
+  table->arena = arena;
+
+  table->bucket_count = 256;
+  table->buckets = make_buckets(table);
+
+  table->symbol_count = 0;
+  table->symbol_capacity = 256;
+  table->symbols = arena_alloc(&table->arena, table->symbol_capacity * sizeof(Symbol*));
+
+  table->scope_count = 0;
+  table->scope_capacity = 8;
+  table->scopes = arena_alloc(&table->arena, table->scope_capacity * sizeof(int));
+
+  // Global scope
+  push_scope(table);
+
+  return table;
+}
+
+void push_scope(SymbolTable* table) {
+  if (table->scope_count == table->scope_capacity) {
+    table->scopes = arena_realloc(
+        &table->arena, table->scopes, table->scope_capacity * sizeof(int), 2 * table->scope_capacity * sizeof(int)
+    );
+    table->scope_capacity *= 2;
+  }
+
+  table->scopes[table->scope_count++] = table->symbol_count;
+}
+
+void pop_scope(SymbolTable* table) {
+  int scope_start = table->scopes[--table->scope_count];
+
+  // Symbols are removed newest first, so each one is at the front of its bucket
+  while (table->symbol_count > scope_start) {
+    Symbol* symbol = table->symbols[--table->symbol_count];
+    unsigned int bucket = hash(symbol->name) & (table->bucket_count - 1);
+    table->buckets[bucket] = symbol->next_in_bucket;
+  }
+}
+
+Symbol* declare_symbol(SymbolTable* table, Declaration declaration) {
+  Identifier identifier;
+  Type type;
+  match(declaration) {
+    of(VariableDeclaration, t, i) {
+      identifier = *i;
+      type = *t;
+    }
+    of(FunctionDeclaration, t, i) {
+      identifier = *i;
+      type = *t;
+    }
+    of(ArrayDeclaration, t, i) {
+      identifier = *i;
+      type = *t;
+    }
+  }
+
+  Symbol* existing = find_symbol(table, identifier);
+  if (existing != NULL && existing->scope == table->scope_count - 1) {
+    return NULL;
+  }
+
+  if (table->symbol_count == table->symbol_capacity) {
+    table->symbols = arena_realloc(
+        &table->arena, table->symbols, table->symbol_capacity * sizeof(Symbol*),
+        2 * table->symbol_capacity * sizeof(Symbol*)
+    );
+    table->symbol_capacity *= 2;
+  }
+  if (table->symbol_count >= table->bucket_count) {
+    grow_buckets(table);
+  }
+
+  Symbol* symbol = arena_alloc(&table->arena, sizeof(Symbol));
+  symbol->name = identifier;
+  symbol->type = type;
+  symbol->declaration = declaration;
+  symbol->implementation = NULL;
+  symbol->scope = table->scope_count - 1;
+
+  table->symbols[table->symbol_count++] = symbol;
+  insert_in_bucket(table, symbol);
+
+  return symbol;
+}
+
+Symbol* find_symbol(SymbolTable* table, Identifier target) {
+  Symbol* symbol = table->buckets[hash(target) & (table->bucket_count - 1)];
+  while (symbol != NULL) {
+    if (symbol->name == target) {
+      return symbol;
+    }
+    symbol = symbol->next_in_bucket;
+  }
+
+  return NULL;
+}
+
+DeclarationSearchResult find_declaration(Identifier target, SymbolTable* table) {
+  Symbol* symbol = find_symbol(table, target);
+  if (symbol == NULL) {
+    return DeclarationNotFound();
+  }
+
+  return DeclarationFound(symbol->declaration, symbol->type, symbol->name);
+}
+
+void free_symbol_table(SymbolTable* table) {
+  // The table itself lives in its arena
+  Arena arena = table->arena;
+  arena_free(&arena);
+}
\ No newline at end of file
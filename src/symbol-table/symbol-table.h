@@ -0,0 +1,48 @@
+#ifndef SYMBOL_TABLE_H
+#define SYMBOL_TABLE_H
+
+#include "arena.h"
+#include "syntax-tree.h"
+
+#include <datatype99.h>
+
+typedef struct Symbol {
+  Identifier name;
+  Type type;
+  Declaration declaration;
+  Implementation* implementation; // NULL while no implementation was found
+  int scope;                      // Nesting depth, 0 is the global scope
+  struct Symbol* next_in_bucket;
+} Symbol;
+
+// Hash table of declarations with nested scopes. Inner scopes shadow outer ones and are dropped as a whole on pop
+typedef struct SymbolTable {
+  Arena arena;
+
+  Symbol** buckets;
+  int bucket_count;
+
+  // Every visible symbol, in declaration order
+  Symbol** symbols;
+  int symbol_count;
+  int symbol_capacity;
+
+  // Index into `symbols` where each open scope starts
+  int* scopes;
+  int scope_count;
+  int scope_capacity;
+} SymbolTable;
+
+datatype(DeclarationSearchResult, (DeclarationNotFound), (DeclarationFound, Declaration, Type, Identifier));
+
+SymbolTable* make_symbol_table();
+void free_symbol_table(SymbolTable* table);
+void push_scope(SymbolTable* table);
+void pop_scope(SymbolTable* table);
+
+// Returns NULL if the identifier is already declared in the innermost scope
+Symbol* declare_symbol(SymbolTable* table, Declaration declaration);
+Symbol* find_symbol(SymbolTable* table, Identifier target);
+DeclarationSearchResult find_declaration(Identifier target, SymbolTable* table);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,109 @@
+#include "time-report.h"
+
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#define MAX_PHASES   16
+#define MAX_COUNTERS 32
+
+typedef struct Phase {
+  const char* name;
+  double wall;   // Seconds
+  double cpu;    // Seconds
+  long peak_rss; // KiB, as seen by the end of the phase
+} Phase;
+
+typedef struct Counter {
+  const char* name;
+  long value;
+} Counter;
+
+static Phase phases[MAX_PHASES];
+static int phase_count = 0;
+static int running = 0;
+static double wall_start, cpu_start;
+
+static Counter counters[MAX_COUNTERS];
+static int counter_count = 0;
+
+static double seconds(clockid_t clock) {
+  struct timespec now;
+  clock_gettime(clock, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static long peak_rss() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+void start_phase(const char* name) {
+  end_phase();
+  if (phase_count == MAX_PHASES) {
+    return;
+  }
+
+  phases[phase_count] = (Phase) { .name = name };
+  running = 1;
+  wall_start = seconds(CLOCK_MONOTONIC);
+  cpu_start = seconds(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+void end_phase() {
+  if (!running) {
+    return;
+  }
+
+  Phase* phase = &phases[phase_count++];
+  phase->wall = seconds(CLOCK_MONOTONIC) - wall_start;
+  phase->cpu = seconds(CLOCK_PROCESS_CPUTIME_ID) - cpu_start;
+  phase->peak_rss = peak_rss();
+  running = 0;
+}
+
+void report_counter(const char* name, long value) {
+  // A missing counter would look like a pass that did nothing, so a full table is a bug, not something to skip
+  if (counter_count == MAX_COUNTERS) {
+    fprintf(stderr, "error: too many counters, raise MAX_COUNTERS to report \"%s\"\n", name);
+    exit(1);
+  }
+
+  counters[counter_count++] = (Counter) { .name = name, .value = value };
+}
+
+void print_time_report(FILE* out) {
+  double total_wall = 0, total_cpu = 0;
+
+  fprintf(out, "%-20s %12s %12s %14s\n", "phase", "wall (ms)", "cpu (ms)", "peak rss (KiB)");
+  for (int i = 0; i < phase_count; i++) {
+    fprintf(
+        out, "%-20s %12.3f %12.3f %14ld\n", phases[i].name, phases[i].wall * 1e3, phases[i].cpu * 1e3,
+        phases[i].peak_rss
+    );
+    total_wall += phases[i].wall;
+    total_cpu += phases[i].cpu;
+  }
+  fprintf(out, "%-20s %12.3f %12.3f %14ld\n", "total", total_wall * 1e3, total_cpu * 1e3, peak_rss());
+
+  fprintf(out, "\n");
+  for (int i = 0; i < counter_count; i++) {
+    fprintf(out, "%-20s %12ld\n", counters[i].name, counters[i].value);
+  }
+}
+
+void print_time_report_json(FILE* out) {
+  fprintf(out, "{\"phases\": [");
+  for (int i = 0; i < phase_count; i++) {
+    fprintf(
+        out, "%s{\"name\": \"%s\", \"wall_ms\": %.3f, \"cpu_ms\": %.3f, \"peak_rss_kib\": %ld}", i == 0 ? "" : ", ",
+        phases[i].name, phases[i].wall * 1e3, phases[i].cpu * 1e3, phases[i].peak_rss
+    );
+  }
+  fprintf(out, "], \"counters\": {");
+  for (int i = 0; i < counter_count; i++) {
+    fprintf(out, "%s\"%s\": %ld", i == 0 ? "" : ", ", counters[i].name, counters[i].value);
+  }
+  fprintf(out, "}}\n");
+}
\ No newline at end of file
@@ -0,0 +1,16 @@
+#ifndef TIME_REPORT_H
+#define TIME_REPORT_H
+
+#include <stdio.h>
+
+// Phases are timed back to back: starting a phase ends the one before it
+void start_phase(const char* name);
+void end_phase();
+
+void report_counter(const char* name, long value);
+
+void print_time_report(FILE* out);
+// Same report on a single line, for tools such as the compiler benchmark
+void print_time_report_json(FILE* out);
+
+#endif
\ No newline at end of file